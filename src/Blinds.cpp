@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "common/lights.hpp"
 
 
 struct Blinds : Module {
@@ -43,6 +44,10 @@ struct Blinds : Module {
 		NUM_LIGHTS
 	};
 
+	common::LightPeak cvPeaks[4];
+	common::LightPeak outPeaks[4];
+	dsp::ClockDivider lightDivider;
+
 	Blinds() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		configParam(GAIN1_PARAM, -1.0, 1.0, 0.0, "Polarity and gain 1");
@@ -53,6 +58,7 @@ struct Blinds : Module {
 		configParam(MOD2_PARAM, -1.0, 1.0, 0.0, "Modulation 2");
 		configParam(MOD3_PARAM, -1.0, 1.0, 0.0, "Modulation 3");
 		configParam(MOD4_PARAM, -1.0, 1.0, 0.0, "Modulation 4");
+		lightDivider.setDivision(common::LIGHT_DIVISION);
 	}
 
 	void process(const ProcessArgs& args) override {
@@ -62,16 +68,22 @@ struct Blinds : Module {
 			float g = params[GAIN1_PARAM + i].getValue();
 			g += params[MOD1_PARAM + i].getValue() * inputs[CV1_INPUT + i].getVoltage() / 5.0;
 			g = clamp(g, -2.0f, 2.0f);
-			lights[CV1_POS_LIGHT + 2 * i].setSmoothBrightness(fmaxf(0.0, g), args.sampleTime);
-			lights[CV1_NEG_LIGHT + 2 * i].setSmoothBrightness(fmaxf(0.0, -g), args.sampleTime);
+			cvPeaks[i].process(g);
 			out += g * inputs[IN1_INPUT + i].getNormalVoltage(5.0);
-			lights[OUT1_POS_LIGHT + 2 * i].setSmoothBrightness(fmaxf(0.0, out / 5.0), args.sampleTime);
-			lights[OUT1_NEG_LIGHT + 2 * i].setSmoothBrightness(fmaxf(0.0, -out / 5.0), args.sampleTime);
+			outPeaks[i].process(out);
 			if (outputs[OUT1_OUTPUT + i].isConnected()) {
 				outputs[OUT1_OUTPUT + i].setVoltage(out);
 				out = 0.0;
 			}
 		}
+
+		if (lightDivider.process()) {
+			float deltaTime = args.sampleTime * lightDivider.getDivision();
+			for (int i = 0; i < 4; i++) {
+				cvPeaks[i].setLights(&lights[CV1_POS_LIGHT + 2 * i], 1.f, deltaTime);
+				outPeaks[i].setLights(&lights[OUT1_POS_LIGHT + 2 * i], 1 / 5.f, deltaTime);
+			}
+		}
 	}
 };
 
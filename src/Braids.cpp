@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "common/resampler.hpp"
 #include "braids/macro_oscillator.h"
 #include "braids/vco_jitter_source.h"
 #include "braids/signature_waveshaper.h"
@@ -33,7 +34,7 @@ struct Braids : Module {
 	braids::VcoJitterSource jitter_source;
 	braids::SignatureWaveshaper ws;
 
-	dsp::SampleRateConverter<1> src;
+	common::PolyphaseResampler<1> src;
 	dsp::DoubleRingBuffer<dsp::Frame<1>, 256> outputBuffer;
 	bool lastTrig = false;
 	bool lowCpu = false;
@@ -60,6 +61,12 @@ struct Braids : Module {
 		settings.meta_modulation = 0;
 		settings.vco_drift = 0;
 		settings.signature = 0;
+
+		onSampleRateChange();
+	}
+
+	void onSampleRateChange() override {
+		src.prepare(96000, APP->engine->getSampleRate());
 	}
 
 	void process(const ProcessArgs& args) override {
@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "common/lights.hpp"
 
 
 struct Branches : Module {
@@ -32,9 +33,12 @@ struct Branches : Module {
 	dsp::BooleanTrigger modeTriggers[2];
 	bool modes[2] = {};
 	bool outcomes[2][16] = {};
+	common::LightPeak statePeaks[2][2];
+	dsp::ClockDivider lightDivider;
 
 	Branches() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		lightDivider.setDivision(common::LIGHT_DIVISION);
 		configParam(THRESHOLD1_PARAM, 0.0, 1.0, 0.5, "Channel 1 probability", "%", 0, 100);
 		configParam(MODE1_PARAM, 0.0, 1.0, 0.0, "Channel 1 mode");
 		configParam(THRESHOLD2_PARAM, 0.0, 1.0, 0.5, "Channel 2 probability", "%", 0, 100);
@@ -93,8 +97,16 @@ struct Branches : Module {
 			outputs[OUT1A_OUTPUT + i].setChannels(channels);
 			outputs[OUT1B_OUTPUT + i].setChannels(channels);
 
-			lights[STATE_LIGHTS + i * 2 + 1].setSmoothBrightness(lightA, args.sampleTime);
-			lights[STATE_LIGHTS + i * 2 + 0].setSmoothBrightness(lightB, args.sampleTime);
+			statePeaks[i][0].process(lightA);
+			statePeaks[i][1].process(lightB);
+		}
+
+		if (lightDivider.process()) {
+			float deltaTime = args.sampleTime * lightDivider.getDivision();
+			for (int i = 0; i < 2; i++) {
+				statePeaks[i][0].setLight(&lights[STATE_LIGHTS + i * 2 + 1], 1.f, deltaTime);
+				statePeaks[i][1].setLight(&lights[STATE_LIGHTS + i * 2 + 0], 1.f, deltaTime);
+			}
 		}
 	}
 
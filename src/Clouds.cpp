@@ -1,5 +1,89 @@
 #include "plugin.hpp"
+#include "common/dspcost.hpp"
+#include "common/resampler.hpp"
+#include "common/idle.hpp"
+#include "common/arena.hpp"
+#include "common/lights.hpp"
+#include "common/worker.hpp"
 #include "clouds/dsp/granular_processor.h"
+#include <emmintrin.h>
+#include <mutex>
+
+
+/** Converts float samples to int16, clamping and truncating toward zero like a scalar cast. `len` must be a multiple of 8. */
+static void convertToShort(const float* in, int16_t* out, int len) {
+	const __m128 scale = _mm_set1_ps(32767.f);
+	const __m128 max = _mm_set1_ps(32767.f);
+	const __m128 min = _mm_set1_ps(-32768.f);
+	for (int i = 0; i < len; i += 8) {
+		__m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(&in[i]), scale), min), max);
+		__m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(&in[i + 4]), scale), min), max);
+		_mm_storeu_si128((__m128i*) &out[i], _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+	}
+}
+
+
+/** Converts int16 samples to float. `len` must be a multiple of 8. */
+static void convertFromShort(const int16_t* in, float* out, int len) {
+	const __m128 scale = _mm_set1_ps(1.f / 32768.f);
+	for (int i = 0; i < len; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i*) &in[i]);
+		// Sign-extend by unpacking into the high halves and shifting back down
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		_mm_storeu_ps(&out[i], _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(&out[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+}
+
+
+/** The granular processor and its buffers at one sample rate and buffer length */
+struct CloudsMemory {
+	/** Buffer sizes of the hardware, which runs at 32 kHz */
+	static const int MEM_LEN = 118784;
+	static const int CCM_LEN = 65536 - 128;
+	/** Largest recording buffer, in bytes.
+	The processor indexes the buffer with int32 and computes grain and loop positions in float, which resolve a quarter sample up to 2^22 samples.
+	At the lowest quality a byte holds one sample, so this keeps every quality within that.
+	*/
+	static const int MAX_MEM_LEN = 1 << 22;
+
+	common::Arena arena;
+	clouds::GranularProcessor* processor = NULL;
+	float rate;
+
+	/** Allocates the processor to run at `rate`.
+	With `bufferLength` = 0, the recording buffer is the hardware's, scaled with the rate so the quality settings keep their durations.
+	Otherwise it holds `bufferLength` seconds of 16-bit stereo, up to MAX_MEM_LEN.
+	*/
+	CloudsMemory(float rate, int bufferLength) {
+		this->rate = rate;
+		size_t memLen = bufferLength ? (size_t) bufferLength * (size_t) rate * 4 : (size_t) (MEM_LEN * rate / 32000.f);
+		memLen = std::min(memLen, (size_t) MAX_MEM_LEN);
+		// Keep the buffer a whole number of cache lines, which also keeps it a whole number of frames at every quality
+		memLen = common::Arena::roundUp(memLen, common::CACHE_LINE);
+		size_t size = common::Arena::footprint<clouds::GranularProcessor>() + common::Arena::footprint<uint8_t>(memLen) + common::Arena::footprint<uint8_t>(CCM_LEN);
+		arena.reserve(size, size >= common::HUGE_PAGE);
+		processor = arena.create<clouds::GranularProcessor>();
+		uint8_t* block_mem = arena.alloc<uint8_t>(memLen);
+		uint8_t* block_ccm = arena.alloc<uint8_t>(CCM_LEN);
+		processor->Init(block_mem, memLen, block_ccm, CCM_LEN);
+	}
+
+	~CloudsMemory() {
+		processor->~GranularProcessor();
+	}
+};
+
+
+/** One block on its way to and from the worker */
+struct CloudsBlock {
+	clouds::ShortFrame input[32];
+	clouds::ShortFrame output[32];
+	clouds::PlaybackMode playback;
+	int quality;
+	clouds::Parameters parameters;
+};
 
 
 struct Clouds : Module {
@@ -46,14 +130,28 @@ struct Clouds : Module {
 		NUM_LIGHTS
 	};
 
-	dsp::SampleRateConverter<2> inputSrc;
-	dsp::SampleRateConverter<2> outputSrc;
+	common::PolyphaseResampler<2> inputSrc;
+	common::PolyphaseResampler<2> outputSrc;
 	dsp::DoubleRingBuffer<dsp::Frame<2>, 256> inputBuffer;
 	dsp::DoubleRingBuffer<dsp::Frame<2>, 256> outputBuffer;
 
-	uint8_t* block_mem;
-	uint8_t* block_ccm;
+	/** Owned by the audio thread. `processor` points into it. */
+	CloudsMemory* memory;
 	clouds::GranularProcessor* processor;
+	/** Allocated by requestMemory() off the audio thread and swapped in between blocks */
+	std::atomic<CloudsMemory*> pendingMemory{NULL};
+	/** Swapped out by the audio thread and freed by requestMemory().
+	The audio thread only swaps while this is empty, so it never overwrites a processor that hasn't been freed.
+	*/
+	std::atomic<CloudsMemory*> retiredMemory{NULL};
+	/** Serializes requestMemory(), which is called from the menu, onSampleRateChange() and dataFromJson() */
+	std::mutex memoryMutex;
+	/** Runs the processor at the engine sample rate instead of 32 kHz, skipping both sample rate conversions.
+	Grain sizes, delay times and the texture diffuser and reverb lengths are counted in samples, so they all scale with the rate.
+	*/
+	bool hostRate = false;
+	/** Recording buffer length in seconds of 16-bit stereo, or 0 for the hardware's */
+	int bufferLength = 0;
 
 	bool triggered = false;
 
@@ -65,8 +163,38 @@ struct Clouds : Module {
 	clouds::PlaybackMode playback;
 	int quality = 0;
 
+	common::DspCost dspCost;
+	common::IdleDetector idle;
+
+	dsp::ClockDivider lightDivider;
+	/** Peak level shown by the VU lights, held between light updates */
+	float vuPeak = 0.f;
+
+	/** Renders on a worker thread, which owns the processor while blocks are queued.
+	Blocks reach the worker through a lock-free single-producer, single-consumer queue and come back a fixed number of blocks later.
+	*/
+	bool multithreaded = false;
+	common::BlockWorker worker;
+	static const int QUEUE_SIZE = 16;
+	/** The spectral mode computes a whole FFT frame in one block, so it always renders on the worker, through a deeper queue that spreads that block's cost.
+	The engine thread then only converts and collects blocks, with or without "Multithreaded".
+	*/
+	static const int SPECTRAL_LATENCY = 8;
+	CloudsBlock queue[QUEUE_SIZE];
+	/** Blocks pushed by the engine thread */
+	std::atomic<int> queueWrite{0};
+	/** Blocks rendered by the worker */
+	std::atomic<int> queueRead{0};
+	/** Blocks between pushing a block and collecting it, or 0 when rendering on the engine thread */
+	int queueLatency = 0;
+	/** First block pushed at the current latency. Earlier slots hold nothing to collect. */
+	int queueStart = 0;
+	/** Freeze state of the last block, kept here because the worker owns the processor's parameters */
+	bool frozen = false;
+
 	Clouds() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		lightDivider.setDivision(common::LIGHT_DIVISION);
 		configParam(POSITION_PARAM, 0.0, 1.0, 0.5, "Grain position");
 		configParam(SIZE_PARAM, 0.0, 1.0, 0.5, "Grain size");
 		configParam(PITCH_PARAM, -2.0, 2.0, 0.0, "Grain pitch");
@@ -81,21 +209,64 @@ struct Clouds : Module {
 		configParam(MODE_PARAM, 0.0, 1.0, 0.0, "Mode");
 		configParam(LOAD_PARAM, 0.0, 1.0, 0.0, "Load/save");
 
-		const int memLen = 118784;
-		const int ccmLen = 65536 - 128;
-		block_mem = new uint8_t[memLen]();
-		block_ccm = new uint8_t[ccmLen]();
-		processor = new clouds::GranularProcessor();
-		memset(processor, 0, sizeof(*processor));
-
-		processor->Init(block_mem, memLen, block_ccm, ccmLen);
+		memory = new CloudsMemory(32000.f, bufferLength);
+		processor = memory->processor;
 		onReset();
+		worker.job = [this](int i) {
+			int read = queueRead.load(std::memory_order_relaxed);
+			while (read != queueWrite.load(std::memory_order_acquire)) {
+				CloudsBlock& block = queue[read % QUEUE_SIZE];
+				processor->set_playback_mode(block.playback);
+				processor->set_quality(block.quality);
+				processor->Prepare();
+				copyParameters(block.parameters, processor->mutable_parameters());
+				processor->Process(block.input, block.output, 32);
+				queueRead.store(++read, std::memory_order_release);
+			}
+		};
+		// The recording buffer and the feedback path can hold audio for several seconds after the input goes silent.
+		idle.holdTime = 10.f;
+		onSampleRateChange();
 	}
 
 	~Clouds() {
-		delete processor;
-		delete[] block_mem;
-		delete[] block_ccm;
+		worker.wait();
+		delete memory;
+		delete pendingMemory.load();
+		delete retiredMemory.load();
+	}
+
+	/** Allocates a processor for the current settings, to be swapped in at the next block.
+	Call from the UI thread or with the engine locked, never from process().
+	*/
+	void requestMemory() {
+		// Calls from different threads would otherwise race to free the retired processor
+		std::lock_guard<std::mutex> lock(memoryMutex);
+		float rate = hostRate ? APP->engine->getSampleRate() : 32000.f;
+		// A pending processor the audio thread hasn't taken yet was never used
+		delete pendingMemory.exchange(new CloudsMemory(rate, bufferLength));
+		// Free the processor swapped out by the last request.
+		// If the audio thread swaps in the new one after this, the one it retires is freed by the next request or the destructor.
+		delete retiredMemory.exchange(NULL);
+	}
+
+	void setHostRate(bool hostRate) {
+		this->hostRate = hostRate;
+		requestMemory();
+	}
+
+	void setBufferLength(int bufferLength) {
+		this->bufferLength = bufferLength;
+		requestMemory();
+	}
+
+	void onSampleRateChange() override {
+		// The 32 kHz kernels are needed even in host-rate mode, for when it is switched off
+		float sampleRate = APP->engine->getSampleRate();
+		inputSrc.prepare(sampleRate, 32000);
+		outputSrc.prepare(32000, sampleRate);
+		if (hostRate)
+			requestMemory();
 	}
 
 	void process(const ProcessArgs& args) override {
@@ -119,82 +290,114 @@ struct Clouds : Module {
 			triggered = true;
 		}
 
+		// The processor keeps running at its old rate until the memory for the new one is swapped in
+		float rate = memory->rate;
+
+		// Skip rendering while the output is silent and there is no input, trigger, or frozen buffer
+		if (outputBuffer.empty() && isIdle()) {
+			inputBuffer.clear();
+			outputSrc.setRates(rate, args.sampleRate);
+			int outLen = outputSrc.skip(32, outputBuffer.capacity());
+			std::memset(outputBuffer.endData(), 0, outLen * sizeof(dsp::Frame<2>));
+			outputBuffer.endIncr(outLen);
+		}
+
 		// Render frames
 		if (outputBuffer.empty()) {
+			dspCost.begin();
+
 			clouds::ShortFrame input[32] = {};
 			// Convert input buffer
 			{
-				inputSrc.setRates(args.sampleRate, 32000);
-				dsp::Frame<2> inputFrames[32];
+				// At equal rates the resampler copies frames through, and the input buffer always holds a full block
+				inputSrc.setRates(args.sampleRate, rate);
+				dsp::Frame<2> inputFrames[32] = {};
 				int inLen = inputBuffer.size();
 				int outLen = 32;
 				inputSrc.process(inputBuffer.startData(), &inLen, inputFrames, &outLen);
 				inputBuffer.startIncr(inLen);
 
 				// We might not fill all of the input buffer if there is a deficiency, but this cannot be avoided due to imprecisions between the input and output SRC.
-				for (int i = 0; i < outLen; i++) {
-					input[i].l = clamp(inputFrames[i].samples[0] * 32767.0f, -32768.0f, 32767.0f);
-					input[i].r = clamp(inputFrames[i].samples[1] * 32767.0f, -32768.0f, 32767.0f);
-				}
+				// The unfilled frames stay silent.
+				convertToShort((const float*) inputFrames, (int16_t*) input, 32 * 2);
 			}
-
-			// Set up processor
-			processor->set_playback_mode(playback);
-			processor->set_quality(quality);
-			processor->Prepare();
-
-			clouds::Parameters* p = processor->mutable_parameters();
-			p->trigger = triggered;
-			p->gate = triggered;
-			p->freeze = freeze || (inputs[FREEZE_INPUT].getVoltage() >= 1.0);
-			p->position = clamp(params[POSITION_PARAM].getValue() + inputs[POSITION_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
-			p->size = clamp(params[SIZE_PARAM].getValue() + inputs[SIZE_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
-			p->pitch = clamp((params[PITCH_PARAM].getValue() + inputs[PITCH_INPUT].getVoltage()) * 12.0f, -48.0f, 48.0f);
-			p->density = clamp(params[DENSITY_PARAM].getValue() + inputs[DENSITY_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
-			p->texture = clamp(params[TEXTURE_PARAM].getValue() + inputs[TEXTURE_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
-			p->dry_wet = params[BLEND_PARAM].getValue();
-			p->stereo_spread = params[SPREAD_PARAM].getValue();
-			p->feedback = params[FEEDBACK_PARAM].getValue();
-			// TODO
-			// Why doesn't dry audio get reverbed?
-			p->reverb = params[REVERB_PARAM].getValue();
-			float blend = inputs[BLEND_INPUT].getVoltage() / 5.0f;
-			switch (blendMode) {
-				case 0:
-					p->dry_wet += blend;
-					p->dry_wet = clamp(p->dry_wet, 0.0f, 1.0f);
-					break;
-				case 1:
-					p->stereo_spread += blend;
-					p->stereo_spread = clamp(p->stereo_spread, 0.0f, 1.0f);
-					break;
-				case 2:
-					p->feedback += blend;
-					p->feedback = clamp(p->feedback, 0.0f, 1.0f);
-					break;
-				case 3:
-					p->reverb += blend;
-					p->reverb = clamp(p->reverb, 0.0f, 1.0f);
-					break;
+			dspCost.lap(common::DspCost::SRC);
+
+			int latency = 0;
+			if (playback == clouds::PLAYBACK_MODE_SPECTRAL)
+				latency = SPECTRAL_LATENCY;
+			else if (multithreaded)
+				latency = 1;
+			// Queued blocks belong to the worker, so let it finish them before the latency or the processor changes
+			// Wait with the swap until the last retired processor has been freed
+			CloudsMemory* newMemory = retiredMemory.load() ? NULL : pendingMemory.exchange(NULL);
+			if (latency != queueLatency || newMemory) {
+				drainQueue();
+				queueLatency = latency;
+				queueStart = queueWrite;
+			}
+			if (newMemory) {
+				CloudsMemory* retired = retiredMemory.exchange(memory);
+				// Only requestMemory() empties retiredMemory, and it was empty above
+				assert(!retired);
+				memory = newMemory;
+				processor = memory->processor;
+				rate = memory->rate;
 			}
 
 			clouds::ShortFrame output[32];
-			processor->Process(input, output, 32);
+			if (queueLatency > 0) {
+				// Push this block
+				int write = queueWrite.load(std::memory_order_relaxed);
+				CloudsBlock& block = queue[write % QUEUE_SIZE];
+				std::memcpy(block.input, input, sizeof(input));
+				block.playback = playback;
+				block.quality = quality;
+				setParameters(&block.parameters);
+				queueWrite.store(++write, std::memory_order_release);
+				if (worker.isDone())
+					worker.post();
+
+				// Collect the block pushed `queueLatency` blocks ago
+				int collect = write - 1 - queueLatency;
+				if (collect >= queueStart) {
+					while (queueRead.load(std::memory_order_acquire) <= collect) {
+						// The worker has fallen behind, or finished just before the block was pushed
+						worker.wait();
+						if (queueRead.load(std::memory_order_acquire) <= collect)
+							worker.post();
+					}
+					std::memcpy(output, queue[collect % QUEUE_SIZE].output, sizeof(output));
+				}
+				else {
+					std::memset(output, 0, sizeof(output));
+				}
+			}
+			else {
+				// Set up processor
+				processor->set_playback_mode(playback);
+				processor->set_quality(quality);
+				processor->Prepare();
+				setParameters(processor->mutable_parameters());
+
+				processor->Process(input, output, 32);
+			}
+			dspCost.lap(common::DspCost::DSP);
+
+			dsp::Frame<2> outputFrames[32];
+			convertFromShort((const int16_t*) output, (float*) outputFrames, 32 * 2);
+			idle.processOutput(common::IdleDetector::getPeak((const float*) outputFrames, 32 * 2), 32 / rate);
 
 			// Convert output buffer
 			{
-				dsp::Frame<2> outputFrames[32];
-				for (int i = 0; i < 32; i++) {
-					outputFrames[i].samples[0] = output[i].l / 32768.0;
-					outputFrames[i].samples[1] = output[i].r / 32768.0;
-				}
-
-				outputSrc.setRates(32000, args.sampleRate);
+				outputSrc.setRates(rate, args.sampleRate);
 				int inLen = 32;
 				int outLen = outputBuffer.capacity();
 				outputSrc.process(outputFrames, &inLen, outputBuffer.endData(), &outLen);
 				outputBuffer.endIncr(outLen);
 			}
+			dspCost.lap(common::DspCost::SRC);
+			dspCost.endBlock();
 
 			triggered = false;
 		}
@@ -208,20 +411,101 @@ struct Clouds : Module {
 		}
 
 		// Lights
-		clouds::Parameters* p = processor->mutable_parameters();
-		dsp::VuMeter vuMeter;
-		vuMeter.dBInterval = 6.0;
-		dsp::Frame<2> lightFrame = p->freeze ? outputFrame : inputFrame;
-		vuMeter.setValue(fmaxf(fabsf(lightFrame.samples[0]), fabsf(lightFrame.samples[1])));
-		lights[FREEZE_LIGHT].setBrightness(p->freeze ? 0.75 : 0.0);
-		lights[MIX_GREEN_LIGHT].setSmoothBrightness(vuMeter.getBrightness(3), args.sampleTime);
-		lights[PAN_GREEN_LIGHT].setSmoothBrightness(vuMeter.getBrightness(2), args.sampleTime);
-		lights[FEEDBACK_GREEN_LIGHT].setSmoothBrightness(vuMeter.getBrightness(1), args.sampleTime);
-		lights[REVERB_GREEN_LIGHT].setBrightness(0.0);
-		lights[MIX_RED_LIGHT].setBrightness(0.0);
-		lights[PAN_RED_LIGHT].setBrightness(0.0);
-		lights[FEEDBACK_RED_LIGHT].setSmoothBrightness(vuMeter.getBrightness(1), args.sampleTime);
-		lights[REVERB_RED_LIGHT].setSmoothBrightness(vuMeter.getBrightness(0), args.sampleTime);
+		dsp::Frame<2> lightFrame = frozen ? outputFrame : inputFrame;
+		vuPeak = std::max(vuPeak, std::max(std::fabs(lightFrame.samples[0]), std::fabs(lightFrame.samples[1])));
+		if (lightDivider.process()) {
+			dspCost.begin();
+			float deltaTime = args.sampleTime * lightDivider.getDivision();
+			dsp::VuMeter vuMeter;
+			vuMeter.dBInterval = 6.0;
+			vuMeter.setValue(vuPeak);
+			vuPeak = 0.f;
+			lights[FREEZE_LIGHT].setBrightness(frozen ? 0.75 : 0.0);
+			lights[MIX_GREEN_LIGHT].setSmoothBrightness(vuMeter.getBrightness(3), deltaTime);
+			lights[PAN_GREEN_LIGHT].setSmoothBrightness(vuMeter.getBrightness(2), deltaTime);
+			lights[FEEDBACK_GREEN_LIGHT].setSmoothBrightness(vuMeter.getBrightness(1), deltaTime);
+			lights[REVERB_GREEN_LIGHT].setBrightness(0.0);
+			lights[MIX_RED_LIGHT].setBrightness(0.0);
+			lights[PAN_RED_LIGHT].setBrightness(0.0);
+			lights[FEEDBACK_RED_LIGHT].setSmoothBrightness(vuMeter.getBrightness(1), deltaTime);
+			lights[REVERB_RED_LIGHT].setSmoothBrightness(vuMeter.getBrightness(0), deltaTime);
+			dspCost.lap(common::DspCost::LIGHTS);
+		}
+	}
+
+	/** Lets the worker finish every queued block and discards their output */
+	void drainQueue() {
+		worker.wait();
+		if (queueRead.load(std::memory_order_acquire) != queueWrite.load(std::memory_order_relaxed)) {
+			worker.post();
+			worker.wait();
+		}
+	}
+
+	/** Copies the parameters set by setParameters() */
+	static void copyParameters(const clouds::Parameters& src, clouds::Parameters* dst) {
+		dst->trigger = src.trigger;
+		dst->gate = src.gate;
+		dst->freeze = src.freeze;
+		dst->position = src.position;
+		dst->size = src.size;
+		dst->pitch = src.pitch;
+		dst->density = src.density;
+		dst->texture = src.texture;
+		dst->dry_wet = src.dry_wet;
+		dst->stereo_spread = src.stereo_spread;
+		dst->feedback = src.feedback;
+		dst->reverb = src.reverb;
+	}
+
+	void setParameters(clouds::Parameters* p) {
+		p->trigger = triggered;
+		p->gate = triggered;
+		p->freeze = freeze || (inputs[FREEZE_INPUT].getVoltage() >= 1.0);
+		frozen = p->freeze;
+		p->position = clamp(params[POSITION_PARAM].getValue() + inputs[POSITION_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
+		p->size = clamp(params[SIZE_PARAM].getValue() + inputs[SIZE_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
+		p->pitch = clamp((params[PITCH_PARAM].getValue() + inputs[PITCH_INPUT].getVoltage()) * 12.0f, -48.0f, 48.0f);
+		p->density = clamp(params[DENSITY_PARAM].getValue() + inputs[DENSITY_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
+		p->texture = clamp(params[TEXTURE_PARAM].getValue() + inputs[TEXTURE_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
+		p->dry_wet = params[BLEND_PARAM].getValue();
+		p->stereo_spread = params[SPREAD_PARAM].getValue();
+		p->feedback = params[FEEDBACK_PARAM].getValue();
+		// TODO
+		// Why doesn't dry audio get reverbed?
+		p->reverb = params[REVERB_PARAM].getValue();
+		float blend = inputs[BLEND_INPUT].getVoltage() / 5.0f;
+		switch (blendMode) {
+			case 0:
+				p->dry_wet += blend;
+				p->dry_wet = clamp(p->dry_wet, 0.0f, 1.0f);
+				break;
+			case 1:
+				p->stereo_spread += blend;
+				p->stereo_spread = clamp(p->stereo_spread, 0.0f, 1.0f);
+				break;
+			case 2:
+				p->feedback += blend;
+				p->feedback = clamp(p->feedback, 0.0f, 1.0f);
+				break;
+			case 3:
+				p->reverb += blend;
+				p->reverb = clamp(p->reverb, 0.0f, 1.0f);
+				break;
+		}
+	}
+
+	bool isIdle() {
+		idle.beginControls();
+		idle.pushModuleControls(this);
+		idle.pushControl(playback);
+		idle.pushControl(quality);
+		idle.pushControl(blendMode);
+
+		bool isFrozen = freeze || inputs[FREEZE_INPUT].getVoltage() >= 1.0 || frozen;
+		float inputPeak = common::IdleDetector::getPeak((const float*) inputBuffer.startData(), 2 * inputBuffer.size());
+		bool excited = triggered || isFrozen || inputPeak >= common::IdleDetector::SILENCE;
+		return idle.isAsleep(excited);
 	}
 
 	void onReset() override {
@@ -229,6 +513,14 @@ struct Clouds : Module {
 		blendMode = 0;
 		playback = clouds::PLAYBACK_MODE_GRANULAR;
 		quality = 0;
+		updatePooled();
+	}
+
+	/** Joins the worker pool while rendering on the worker, in spectral mode or with "Multithreaded" on.
+	Call from the UI thread or dataFromJson(), never from process().
+	*/
+	void updatePooled() {
+		worker.setPooled(multithreaded || playback == clouds::PLAYBACK_MODE_SPECTRAL);
 	}
 
 	json_t* dataToJson() override {
@@ -237,6 +529,10 @@ struct Clouds : Module {
 		json_object_set_new(rootJ, "playback", json_integer((int) playback));
 		json_object_set_new(rootJ, "quality", json_integer(quality));
 		json_object_set_new(rootJ, "blendMode", json_integer(blendMode));
+		json_object_set_new(rootJ, "hostRate", json_boolean(hostRate));
+		json_object_set_new(rootJ, "bufferLength", json_integer(bufferLength));
+		json_object_set_new(rootJ, "multithreaded", json_boolean(multithreaded));
+		json_object_set_new(rootJ, "dspCost", dspCost.toJson());
 
 		return rootJ;
 	}
@@ -256,6 +552,30 @@ struct Clouds : Module {
 		if (blendModeJ) {
 			blendMode = json_integer_value(blendModeJ);
 		}
+
+		json_t* hostRateJ = json_object_get(rootJ, "hostRate");
+		if (hostRateJ) {
+			hostRate = json_boolean_value(hostRateJ);
+		}
+
+		json_t* bufferLengthJ = json_object_get(rootJ, "bufferLength");
+		if (bufferLengthJ) {
+			bufferLength = json_integer_value(bufferLengthJ);
+		}
+
+		if (hostRate || bufferLength)
+			requestMemory();
+
+		json_t* multithreadedJ = json_object_get(rootJ, "multithreaded");
+		if (multithreadedJ) {
+			multithreaded = json_boolean_value(multithreadedJ);
+		}
+		updatePooled();
+
+		json_t* dspCostJ = json_object_get(rootJ, "dspCost");
+		if (dspCostJ) {
+			dspCost.fromJson(dspCostJ);
+		}
 	}
 };
 
@@ -286,6 +606,7 @@ struct CloudsPlaybackItem : MenuItem {
 	clouds::PlaybackMode playback;
 	void onAction(const event::Action& e) override {
 		module->playback = playback;
+		module->updatePooled();
 	}
 	void step() override {
 		rightText = (module->playback == playback) ? "✔" : "";
@@ -307,6 +628,44 @@ struct CloudsQualityItem : MenuItem {
 };
 
 
+struct CloudsBufferLengthItem : MenuItem {
+	Clouds* module;
+	int bufferLength;
+	void onAction(const event::Action& e) override {
+		module->setBufferLength(bufferLength);
+	}
+	void step() override {
+		rightText = (module->bufferLength == bufferLength) ? "✔" : "";
+		MenuItem::step();
+	}
+};
+
+
+struct CloudsHostRateItem : MenuItem {
+	Clouds* module;
+	void onAction(const event::Action& e) override {
+		module->setHostRate(!module->hostRate);
+	}
+	void step() override {
+		rightText = module->hostRate ? "✔" : "";
+		MenuItem::step();
+	}
+};
+
+
+struct CloudsMultithreadedItem : MenuItem {
+	Clouds* module;
+	void onAction(const event::Action& e) override {
+		module->multithreaded ^= true;
+		module->updatePooled();
+	}
+	void step() override {
+		rightText = CHECKMARK(module->multithreaded);
+		MenuItem::step();
+	}
+};
+
+
 struct CloudsWidget : ModuleWidget {
 	ParamWidget* blendParam;
 	ParamWidget* spreadParam;
@@ -394,12 +753,31 @@ struct CloudsWidget : ModuleWidget {
 		menu->addChild(construct<CloudsPlaybackItem>(&MenuItem::text, "Looping delay", &CloudsPlaybackItem::module, module, &CloudsPlaybackItem::playback, clouds::PLAYBACK_MODE_LOOPING_DELAY));
 		menu->addChild(construct<CloudsPlaybackItem>(&MenuItem::text, "Spectral madness", &CloudsPlaybackItem::module, module, &CloudsPlaybackItem::playback, clouds::PLAYBACK_MODE_SPECTRAL));
 
+		// Latencies are whole 32-sample blocks at the processor's rate
+		float rate = module->hostRate ? APP->engine->getSampleRate() : 32000.f;
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, string::f("Spectral madness renders on a worker thread, %.2g ms later", 1000.f * 32 * Clouds::SPECTRAL_LATENCY / rate)));
+
 		menu->addChild(new MenuSeparator);
 		menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Quality"));
 		menu->addChild(construct<CloudsQualityItem>(&MenuItem::text, "1s 32kHz 16-bit stereo", &CloudsQualityItem::module, module, &CloudsQualityItem::quality, 0));
 		menu->addChild(construct<CloudsQualityItem>(&MenuItem::text, "2s 32kHz 16-bit mono", &CloudsQualityItem::module, module, &CloudsQualityItem::quality, 1));
 		menu->addChild(construct<CloudsQualityItem>(&MenuItem::text, "4s 16kHz 8-bit µ-law stereo", &CloudsQualityItem::module, module, &CloudsQualityItem::quality, 2));
 		menu->addChild(construct<CloudsQualityItem>(&MenuItem::text, "8s 16kHz 8-bit µ-law mono", &CloudsQualityItem::module, module, &CloudsQualityItem::quality, 3));
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Buffer length at 16-bit stereo, up to 4 MB"));
+		menu->addChild(construct<CloudsBufferLengthItem>(&MenuItem::text, "1s (hardware)", &CloudsBufferLengthItem::module, module, &CloudsBufferLengthItem::bufferLength, 0));
+		menu->addChild(construct<CloudsBufferLengthItem>(&MenuItem::text, "10s", &CloudsBufferLengthItem::module, module, &CloudsBufferLengthItem::bufferLength, 10));
+		menu->addChild(construct<CloudsBufferLengthItem>(&MenuItem::text, "20s", &CloudsBufferLengthItem::module, module, &CloudsBufferLengthItem::bufferLength, 20));
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(construct<CloudsHostRateItem>(&MenuItem::text, "Run at engine sample rate", &CloudsHostRateItem::module, module));
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Grains, delays and reverb scale with the rate"));
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(construct<CloudsMultithreadedItem>(&MenuItem::text, "Multithreaded", &CloudsMultithreadedItem::module, module));
+		menu->addChild(construct<MenuLabel>(&MenuLabel::text, string::f("Adds %.2g ms of latency to the other modes", 1000.f * 32 / rate)));
+		common::appendDspCostMenu(menu, &module->dspCost, {common::DspCost::DSP, common::DspCost::SRC, common::DspCost::LIGHTS});
 	}
 };
 
@@ -1,4 +1,10 @@
 #include "plugin.hpp"
+#include "common/dspcost.hpp"
+#include "common/resampler.hpp"
+#include "common/idle.hpp"
+#include "common/guard.hpp"
+#include "common/worker.hpp"
+#include "common/arena.hpp"
 #include "elements/dsp/part.h"
 
 
@@ -70,13 +76,28 @@ struct Elements : Module {
 		NUM_LIGHTS
 	};
 
-	dsp::SampleRateConverter<2> inputSrc;
-	dsp::SampleRateConverter<2> outputSrc;
+	common::PolyphaseResampler<2> inputSrc;
+	common::PolyphaseResampler<2> outputSrc;
 	dsp::DoubleRingBuffer<dsp::Frame<2>, 256> inputBuffer;
 	dsp::DoubleRingBuffer<dsp::Frame<2>, 256> outputBuffer;
 
-	uint16_t reverb_buffer[32768] = {};
+	/** Holds the part and its reverb buffer */
+	common::Arena arena;
+	static const int REVERB_SIZE = 32768;
+	uint16_t* reverb_buffer;
 	elements::Part* part;
+	common::DspCost dspCost;
+	common::DspGuard dspGuard;
+	common::IdleDetector idle;
+
+	/** Renders on a worker thread, one block (0.5 ms) behind the engine */
+	bool multithreaded = false;
+	common::BlockWorker worker;
+	elements::PerformanceState asyncPerformance = {};
+	float asyncBlow[16] = {};
+	float asyncStrike[16] = {};
+	float asyncMain[16] = {};
+	float asyncAux[16] = {};
 
 	Elements() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -109,17 +130,48 @@ struct Elements : Module {
 		configParam(SPACE_MOD_PARAM, -2.0, 2.0, 0.0, "Reverb space attenuverter");
 		configParam(PLAY_PARAM, 0.0, 1.0, 0.0, "Play");
 
-		part = new elements::Part();
+		arena.reserve(common::Arena::footprint<elements::Part>() + common::Arena::footprint<uint16_t>(REVERB_SIZE));
+		part = arena.create<elements::Part>();
+		reverb_buffer = arena.alloc<uint16_t>(REVERB_SIZE);
+		initPart();
+
+		worker.job = [this](int i) {
+			part->Process(asyncPerformance, asyncBlow, asyncStrike, asyncMain, asyncAux, 16);
+		};
+		onSampleRateChange();
+	}
+
+	void onSampleRateChange() override {
+		float sampleRate = APP->engine->getSampleRate();
+		inputSrc.prepare(sampleRate, 32000);
+		outputSrc.prepare(32000, sampleRate);
+	}
+
+	~Elements() {
+		worker.wait();
+		part->~Part();
+	}
+
+	/** Clears the part and its reverb. The worker must be idle. */
+	void initPart() {
 		// In the Mutable Instruments code, Part doesn't initialize itself, so zero it here.
 		memset(part, 0, sizeof(*part));
+		memset(reverb_buffer, 0, REVERB_SIZE * sizeof(uint16_t));
 		part->Init(reverb_buffer);
 		// Just some random numbers
 		uint32_t seed[3] = {1, 2, 3};
 		part->Seed(seed, 3);
 	}
 
-	~Elements() {
-		delete part;
+	/** Resets the part and silences the block if the guard finds a non-finite sample */
+	void guardOutput(float* main, float* aux, int size) {
+		if (dspGuard.check(main, size) || dspGuard.check(aux, size)) {
+			int model = getModel();
+			initPart();
+			setModel(model);
+			std::memset(main, 0, size * sizeof(float));
+			std::memset(aux, 0, size * sizeof(float));
+		}
 	}
 
 	void process(const ProcessArgs& args) override {
@@ -131,8 +183,23 @@ struct Elements : Module {
 			inputBuffer.push(inputFrame);
 		}
 
+		// Skip rendering while the resonator is silent and nothing excites it
+		if (outputBuffer.empty() && isIdle()) {
+			inputBuffer.clear();
+			outputSrc.setRates(32000, args.sampleRate);
+			int outLen = outputSrc.skip(16, outputBuffer.capacity());
+			std::memset(outputBuffer.endData(), 0, outLen * sizeof(dsp::Frame<2>));
+			outputBuffer.endIncr(outLen);
+
+			lights[GATE_LIGHT].setBrightness(0.0);
+			lights[EXCITER_LIGHT].setBrightness(0.0);
+			lights[RESONATOR_LIGHT].setBrightness(0.0);
+		}
+
 		// Render frames
 		if (outputBuffer.empty()) {
+			dspCost.begin();
+
 			float blow[16] = {};
 			float strike[16] = {};
 			float main[16];
@@ -152,6 +219,10 @@ struct Elements : Module {
 					strike[i] = inputFrames[i].samples[1];
 				}
 			}
+			dspCost.lap(common::DspCost::SRC);
+
+			// The part is only touched by one thread at a time, so wait for the previous block
+			worker.wait();
 
 			// Set patch from parameters
 			elements::Patch* p = part->mutable_patch();
@@ -181,7 +252,30 @@ struct Elements : Module {
 			performance.strength = clamp(1.0 - inputs[STRENGTH_INPUT].getVoltage() / 5.0f, 0.0f, 1.0f);
 
 			// Generate audio
-			part->Process(performance, blow, strike, main, aux, 16);
+			float exciterLevel;
+			float resonatorLevel;
+			if (multithreaded) {
+				// Collect the previous block and hand this one to the worker
+				std::memcpy(main, asyncMain, sizeof(main));
+				std::memcpy(aux, asyncAux, sizeof(aux));
+				guardOutput(main, aux, 16);
+				exciterLevel = part->exciter_level();
+				resonatorLevel = part->resonator_level();
+				asyncPerformance = performance;
+				std::memcpy(asyncBlow, blow, sizeof(blow));
+				std::memcpy(asyncStrike, strike, sizeof(strike));
+				worker.post();
+			}
+			else {
+				part->Process(performance, blow, strike, main, aux, 16);
+				guardOutput(main, aux, 16);
+				exciterLevel = part->exciter_level();
+				resonatorLevel = part->resonator_level();
+			}
+			dspCost.lap(common::DspCost::DSP);
+
+			float peak = std::max(common::IdleDetector::getPeak(main, 16), common::IdleDetector::getPeak(aux, 16));
+			idle.processOutput(peak, 16 / 32000.f);
 
 			// Convert output buffer
 			{
@@ -197,11 +291,14 @@ struct Elements : Module {
 				outputSrc.process(outputFrames, &inLen, outputBuffer.endData(), &outLen);
 				outputBuffer.endIncr(outLen);
 			}
+			dspCost.lap(common::DspCost::SRC);
 
 			// Set lights
 			lights[GATE_LIGHT].setBrightness(performance.gate ? 0.75 : 0.0);
-			lights[EXCITER_LIGHT].setBrightness(part->exciter_level());
-			lights[RESONATOR_LIGHT].setBrightness(part->resonator_level());
+			lights[EXCITER_LIGHT].setBrightness(exciterLevel);
+			lights[RESONATOR_LIGHT].setBrightness(resonatorLevel);
+			dspCost.lap(common::DspCost::LIGHTS);
+			dspCost.endBlock();
 		}
 
 		// Set output
@@ -212,9 +309,23 @@ struct Elements : Module {
 		}
 	}
 
+	bool isIdle() {
+		idle.beginControls();
+		idle.pushModuleControls(this);
+		idle.pushControl(getModel());
+
+		bool gate = params[PLAY_PARAM].getValue() >= 1.0 || inputs[GATE_INPUT].getVoltage() >= 1.0;
+		float inputPeak = common::IdleDetector::getPeak((const float*) inputBuffer.startData(), 2 * inputBuffer.size());
+		bool excited = gate || inputPeak >= common::IdleDetector::SILENCE;
+		return idle.isAsleep(excited);
+	}
+
 	json_t* dataToJson() override {
 		json_t* rootJ = json_object();
 		json_object_set_new(rootJ, "model", json_integer(getModel()));
+		json_object_set_new(rootJ, "multithreaded", json_boolean(multithreaded));
+		json_object_set_new(rootJ, "dspCost", dspCost.toJson());
+		json_object_set_new(rootJ, "dspGuard", dspGuard.toJson());
 		return rootJ;
 	}
 
@@ -223,6 +334,22 @@ struct Elements : Module {
 		if (modelJ) {
 			setModel(json_integer_value(modelJ));
 		}
+
+		json_t* multithreadedJ = json_object_get(rootJ, "multithreaded");
+		if (multithreadedJ) {
+			multithreaded = json_boolean_value(multithreadedJ);
+			worker.setPooled(multithreaded);
+		}
+
+		json_t* dspCostJ = json_object_get(rootJ, "dspCost");
+		if (dspCostJ) {
+			dspCost.fromJson(dspCostJ);
+		}
+
+		json_t* dspGuardJ = json_object_get(rootJ, "dspGuard");
+		if (dspGuardJ) {
+			dspGuard.fromJson(dspGuardJ);
+		}
 	}
 
 	int getModel() {
@@ -335,6 +462,10 @@ struct ElementsWidget : ModuleWidget {
 		menu->addChild(construct<ElementsModalItem>(&MenuItem::text, "Original", &ElementsModalItem::elements, elements, &ElementsModalItem::model, 0));
 		menu->addChild(construct<ElementsModalItem>(&MenuItem::text, "Non-linear string", &ElementsModalItem::elements, elements, &ElementsModalItem::model, 1));
 		menu->addChild(construct<ElementsModalItem>(&MenuItem::text, "Chords", &ElementsModalItem::elements, elements, &ElementsModalItem::model, 2));
+
+		common::appendMultithreadedMenu(menu, &elements->multithreaded, &elements->worker, "0.5 ms");
+		common::appendDspGuardMenu(menu, &elements->dspGuard);
+		common::appendDspCostMenu(menu, &elements->dspCost, {common::DspCost::DSP, common::DspCost::SRC, common::DspCost::LIGHTS});
 	}
 };
 
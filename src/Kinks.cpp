@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "common/lights.hpp"
 
 
 struct Kinks : Module {
@@ -32,9 +33,13 @@ struct Kinks : Module {
 
 	dsp::SchmittTrigger trigger;
 	float sample = 0.0;
+	common::LightPeak signPeak;
+	common::LightPeak logicPeak;
+	dsp::ClockDivider lightDivider;
 
 	Kinks() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		lightDivider.setDivision(common::LIGHT_DIVISION);
 	}
 
 	void process(const ProcessArgs& args) override {
@@ -47,13 +52,15 @@ struct Kinks : Module {
 		}
 
 		// lights
-		lights[SIGN_POS_LIGHT].setSmoothBrightness(fmaxf(0.0, inputs[SIGN_INPUT].getVoltage() / 5.0), args.sampleTime);
-		lights[SIGN_NEG_LIGHT].setSmoothBrightness(fmaxf(0.0, -inputs[SIGN_INPUT].getVoltage() / 5.0), args.sampleTime);
-		float logicSum = inputs[LOGIC_A_INPUT].getVoltage() + inputs[LOGIC_B_INPUT].getVoltage();
-		lights[LOGIC_POS_LIGHT].setSmoothBrightness(fmaxf(0.0, logicSum / 5.0), args.sampleTime);
-		lights[LOGIC_NEG_LIGHT].setSmoothBrightness(fmaxf(0.0, -logicSum / 5.0), args.sampleTime);
-		lights[SH_POS_LIGHT].setBrightness(fmaxf(0.0, sample / 5.0));
-		lights[SH_NEG_LIGHT].setBrightness(fmaxf(0.0, -sample / 5.0));
+		signPeak.process(inputs[SIGN_INPUT].getVoltage());
+		logicPeak.process(inputs[LOGIC_A_INPUT].getVoltage() + inputs[LOGIC_B_INPUT].getVoltage());
+		if (lightDivider.process()) {
+			float deltaTime = args.sampleTime * lightDivider.getDivision();
+			signPeak.setLights(&lights[SIGN_POS_LIGHT], 1 / 5.f, deltaTime);
+			logicPeak.setLights(&lights[LOGIC_POS_LIGHT], 1 / 5.f, deltaTime);
+			lights[SH_POS_LIGHT].setBrightness(fmaxf(0.0, sample / 5.0));
+			lights[SH_NEG_LIGHT].setBrightness(fmaxf(0.0, -sample / 5.0));
+		}
 
 		// outputs
 		outputs[INVERT_OUTPUT].setVoltage(-inputs[SIGN_INPUT].getVoltage());
@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "common/lights.hpp"
 
 
 struct Links : Module {
@@ -30,8 +31,12 @@ struct Links : Module {
 		NUM_LIGHTS
 	};
 
+	common::LightPeak peaks[3];
+	dsp::ClockDivider lightDivider;
+
 	Links() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		lightDivider.setDivision(common::LIGHT_DIVISION);
 	}
 
 	void process(const ProcessArgs& args) override {
@@ -48,8 +53,7 @@ struct Links : Module {
 			outputs[A1_OUTPUT].setChannels(channels);
 			outputs[A2_OUTPUT].setChannels(channels);
 			outputs[A3_OUTPUT].setChannels(channels);
-			lights[A_LIGHT + 0].setSmoothBrightness(in[0] / 5.f, args.sampleTime);
-			lights[A_LIGHT + 1].setSmoothBrightness(-in[0] / 5.f, args.sampleTime);
+			peaks[0].process(in[0]);
 		}
 
 		// Section B
@@ -63,8 +67,7 @@ struct Links : Module {
 			}
 			outputs[B1_OUTPUT].setChannels(channels);
 			outputs[B2_OUTPUT].setChannels(channels);
-			lights[B_LIGHT + 0].setSmoothBrightness(in[0] / 5.f, args.sampleTime);
-			lights[B_LIGHT + 1].setSmoothBrightness(-in[0] / 5.f, args.sampleTime);
+			peaks[1].process(in[0]);
 		}
 
 		// Section C
@@ -76,8 +79,14 @@ struct Links : Module {
 				outputs[C1_OUTPUT].setVoltage(in[c], c);
 			}
 			outputs[C1_OUTPUT].setChannels(channels);
-			lights[C_LIGHT + 0].setSmoothBrightness(in[0] / 5.f, args.sampleTime);
-			lights[C_LIGHT + 1].setSmoothBrightness(-in[0] / 5.f, args.sampleTime);
+			peaks[2].process(in[0]);
+		}
+
+		if (lightDivider.process()) {
+			float deltaTime = args.sampleTime * lightDivider.getDivision();
+			peaks[0].setLights(&lights[A_LIGHT], 1 / 5.f, deltaTime);
+			peaks[1].setLights(&lights[B_LIGHT], 1 / 5.f, deltaTime);
+			peaks[2].setLights(&lights[C_LIGHT], 1 / 5.f, deltaTime);
 		}
 	}
 };
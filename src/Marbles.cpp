@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "common/lights.hpp"
 #include "marbles/random/random_generator.h"
 #include "marbles/random/random_stream.h"
 #include "marbles/random/t_generator.h"
@@ -223,8 +224,13 @@ struct Marbles : Module {
 	float voltages[BLOCK_SIZE * 4] = {};
 	int blockIndex = 0;
 
+	common::LightPeak tPeaks[3];
+	common::LightPeak xyPeaks[4];
+	dsp::ClockDivider lightDivider;
+
 	Marbles() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		lightDivider.setDivision(common::LIGHT_DIVISION);
 		configParam(T_DEJA_VU_PARAM, 0.0, 1.0, 0.0, "t deja vu");
 		configParam(X_DEJA_VU_PARAM, 0.0, 1.0, 0.0, "X deja vu");
 		configParam(DEJA_VU_PARAM, 0.0, 1.0, 0.5, "Deja vu probability");
@@ -379,38 +385,50 @@ struct Marbles : Module {
 
 		// Lights and outputs
 
-		lights[T_DEJA_VU_LIGHT].setBrightness(t_deja_vu);
-		lights[X_DEJA_VU_LIGHT].setBrightness(x_deja_vu);
-
-		lights[T_MODE_LIGHTS + 0].setBrightness(t_mode == 0 || t_mode == 1);
-		lights[T_MODE_LIGHTS + 1].setBrightness(t_mode == 1 || t_mode == 2);
-
-		lights[X_MODE_LIGHTS + 0].setBrightness(x_mode == 0 || x_mode == 1);
-		lights[X_MODE_LIGHTS + 1].setBrightness(x_mode == 1 || x_mode == 2);
-
-		lights[T_RANGE_LIGHTS + 0].setBrightness(t_range == 0 || t_range == 1);
-		lights[T_RANGE_LIGHTS + 1].setBrightness(t_range == 1 || t_range == 2);
-
-		lights[X_RANGE_LIGHTS + 0].setBrightness(x_range == 0 || x_range == 1);
-		lights[X_RANGE_LIGHTS + 1].setBrightness(x_range == 1 || x_range == 2);
-
-		lights[EXTERNAL_LIGHT].setBrightness(external);
-
 		outputs[T1_OUTPUT].setVoltage(gates[blockIndex * 2 + 0] ? 10.f : 0.f);
-		lights[T1_LIGHT].setSmoothBrightness(gates[blockIndex * 2 + 0], args.sampleTime);
+		tPeaks[0].process(gates[blockIndex * 2 + 0]);
 		outputs[T2_OUTPUT].setVoltage((ramp_master[blockIndex] < 0.5f) ? 10.f : 0.f);
-		lights[T2_LIGHT].setSmoothBrightness(ramp_master[blockIndex] < 0.5f, args.sampleTime);
+		tPeaks[1].process(ramp_master[blockIndex] < 0.5f);
 		outputs[T3_OUTPUT].setVoltage(gates[blockIndex * 2 + 1] ? 10.f : 0.f);
-		lights[T3_LIGHT].setSmoothBrightness(gates[blockIndex * 2 + 1], args.sampleTime);
+		tPeaks[2].process(gates[blockIndex * 2 + 1]);
 
 		outputs[X1_OUTPUT].setVoltage(voltages[blockIndex * 4 + 0]);
-		lights[X1_LIGHT].setSmoothBrightness(voltages[blockIndex * 4 + 0], args.sampleTime);
 		outputs[X2_OUTPUT].setVoltage(voltages[blockIndex * 4 + 1]);
-		lights[X2_LIGHT].setSmoothBrightness(voltages[blockIndex * 4 + 1], args.sampleTime);
 		outputs[X3_OUTPUT].setVoltage(voltages[blockIndex * 4 + 2]);
-		lights[X3_LIGHT].setSmoothBrightness(voltages[blockIndex * 4 + 2], args.sampleTime);
 		outputs[Y_OUTPUT].setVoltage(voltages[blockIndex * 4 + 3]);
-		lights[Y_LIGHT].setSmoothBrightness(voltages[blockIndex * 4 + 3], args.sampleTime);
+		for (int i = 0; i < 4; i++) {
+			xyPeaks[i].process(voltages[blockIndex * 4 + i]);
+		}
+
+		if (lightDivider.process()) {
+			float deltaTime = args.sampleTime * lightDivider.getDivision();
+
+			lights[T_DEJA_VU_LIGHT].setBrightness(t_deja_vu);
+			lights[X_DEJA_VU_LIGHT].setBrightness(x_deja_vu);
+
+			lights[T_MODE_LIGHTS + 0].setBrightness(t_mode == 0 || t_mode == 1);
+			lights[T_MODE_LIGHTS + 1].setBrightness(t_mode == 1 || t_mode == 2);
+
+			lights[X_MODE_LIGHTS + 0].setBrightness(x_mode == 0 || x_mode == 1);
+			lights[X_MODE_LIGHTS + 1].setBrightness(x_mode == 1 || x_mode == 2);
+
+			lights[T_RANGE_LIGHTS + 0].setBrightness(t_range == 0 || t_range == 1);
+			lights[T_RANGE_LIGHTS + 1].setBrightness(t_range == 1 || t_range == 2);
+
+			lights[X_RANGE_LIGHTS + 0].setBrightness(x_range == 0 || x_range == 1);
+			lights[X_RANGE_LIGHTS + 1].setBrightness(x_range == 1 || x_range == 2);
+
+			lights[EXTERNAL_LIGHT].setBrightness(external);
+
+			tPeaks[0].setLight(&lights[T1_LIGHT], 1.f, deltaTime);
+			tPeaks[1].setLight(&lights[T2_LIGHT], 1.f, deltaTime);
+			tPeaks[2].setLight(&lights[T3_LIGHT], 1.f, deltaTime);
+
+			xyPeaks[0].setLight(&lights[X1_LIGHT], 1.f, deltaTime);
+			xyPeaks[1].setLight(&lights[X2_LIGHT], 1.f, deltaTime);
+			xyPeaks[2].setLight(&lights[X3_LIGHT], 1.f, deltaTime);
+			xyPeaks[3].setLight(&lights[Y_LIGHT], 1.f, deltaTime);
+		}
 	}
 
 	void stepBlock() {
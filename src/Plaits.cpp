@@ -1,4 +1,10 @@
 #include "plugin.hpp"
+#include "common/dspcost.hpp"
+#include "common/resampler.hpp"
+#include "common/idle.hpp"
+#include "common/arena.hpp"
+#include "common/worker.hpp"
+#include "common/lights.hpp"
 
 #pragma GCC diagnostic push
 #ifndef __clang__
@@ -6,6 +12,27 @@
 #endif
 #include "plaits/dsp/voice.h"
 #pragma GCC diagnostic pop
+#include <mutex>
+
+
+/** A voice and its engine buffer, allocated together off the audio thread */
+struct PlaitsVoice {
+	static const int SHARED_BUFFER_SIZE = 16384;
+	common::Arena arena;
+	plaits::Voice* voice;
+
+	PlaitsVoice() {
+		arena.reserve(common::Arena::footprint<plaits::Voice>() + common::Arena::footprint<char>(SHARED_BUFFER_SIZE));
+		voice = arena.create<plaits::Voice>();
+		char* buffer = arena.alloc<char>(SHARED_BUFFER_SIZE);
+		stmlib::BufferAllocator allocator(buffer, SHARED_BUFFER_SIZE);
+		voice->Init(&allocator);
+	}
+
+	~PlaitsVoice() {
+		voice->~Voice();
+	}
+};
 
 
 struct Plaits : Module {
@@ -44,14 +71,68 @@ struct Plaits : Module {
 		NUM_LIGHTS
 	};
 
-	plaits::Voice voice[16];
+	static const int MAX_BLOCK_SIZE = 24;
+	/** Seconds of silence before a voice whose low-pass gate has closed stops rendering */
+	static constexpr float LPG_TAIL_TIME = 0.05f;
+	/** Seconds a voice above the channel count is kept before it is released */
+	static constexpr float VOICE_RELEASE_TIME = 10.f;
+	/** Voices are allocated by updateVoices() off the audio thread when the channel count first reaches them.
+	A channel without a voice yet stays silent until updateVoices() catches up.
+	*/
+	std::atomic<PlaitsVoice*> voices[16];
+	/** Voices released by the audio thread, freed by updateVoices() */
+	std::atomic<PlaitsVoice*> retiredVoices[16];
+	/** Channel count of the last block, read by updateVoices() */
+	std::atomic<int> voiceDemand{1};
+	/** Serializes updateVoices(), which is called from the UI thread and from dataFromJson() */
+	std::mutex voiceMutex;
+	/** The audio thread's view of `voices`, taken at the start of each block */
+	plaits::Voice* voice[16] = {};
+	float voiceUnusedTime[16] = {};
 	plaits::Patch patch = {};
-	char shared_buffer[16][16384] = {};
 	float triPhase = 0.f;
 
-	dsp::SampleRateConverter<16 * 2> outputSrc;
+	/** Knobs that can be set per voice: harmonics, timbre, morph, LPG colour and decay */
+	static const int NUM_VOICE_KNOBS = 5;
+	/** Seconds for a voice's knob layer to glide to a new value */
+	static constexpr float VOICE_KNOB_SMOOTH_TIME = 0.01f;
+	/** A voice follows the panel knobs until a layer is stored for it */
+	bool voiceKnobsSet[16] = {};
+	float voiceKnobs[16][NUM_VOICE_KNOBS] = {};
+	float smoothedKnobs[16][NUM_VOICE_KNOBS] = {};
+	/** Voice whose layer the panel knobs are editing, or -1 for all voices */
+	int editVoice = -1;
+	/** Panel knob values put aside while a single voice is being edited */
+	float sharedKnobs[NUM_VOICE_KNOBS] = {};
+	plaits::Patch voicePatch[16] = {};
+
+	common::PolyphaseResampler<16 * 2> outputSrc;
 	dsp::DoubleRingBuffer<dsp::Frame<16 * 2>, 256> outputBuffer;
 	bool lowCpu = false;
+	/** Frames rendered per internal block. Smaller blocks lower the trigger-to-sound latency, larger ones raise throughput.
+	Set from the UI thread and read once at the start of each block.
+	*/
+	std::atomic<int> blockSize{12};
+	/** Converts to the host rate with a short resampler kernel, for less delay at some cost in aliasing */
+	bool tight = false;
+	static const int TIGHT_TAPS = 16;
+	dsp::ClockDivider lightDivider;
+	common::DspCost dspCost;
+	common::IdleDetector idle[16];
+
+	/** Renders the voices on the shared worker pool, one block behind the engine.
+	Each active voice is a task of its own, so only as many threads wake as there are voices to render.
+	*/
+	bool multithreaded = false;
+	common::BlockWorker worker;
+	plaits::Patch asyncPatch[16] = {};
+	plaits::Modulations asyncModulations[16] = {};
+	bool asyncActive[16] = {};
+	/** Channels of the active voices, one per task */
+	int asyncVoices[16] = {};
+	int asyncChannels = 0;
+	int asyncBlockSize = 0;
+	plaits::Voice::Frame asyncOutput[16][MAX_BLOCK_SIZE] = {};
 
 	dsp::BooleanTrigger model1Trigger;
 	dsp::BooleanTrigger model2Trigger;
@@ -70,18 +151,111 @@ struct Plaits : Module {
 		configParam(FREQ_CV_PARAM, -1.0, 1.0, 0.0, "Frequency CV");
 		configParam(MORPH_CV_PARAM, -1.0, 1.0, 0.0, "Morph CV");
 
-		for (int i = 0; i < 16; i++) {
-			stmlib::BufferAllocator allocator(shared_buffer[i], sizeof(shared_buffer[i]));
-			voice[i].Init(&allocator);
+		for (int c = 0; c < 16; c++) {
+			voices[c] = NULL;
+			retiredVoices[c] = NULL;
 		}
-
+		updateVoices();
 		onReset();
+
+		worker.job = [this](int i) {
+			int c = asyncVoices[i];
+			voice[c]->Render(asyncPatch[c], asyncModulations[c], asyncOutput[c], asyncBlockSize);
+		};
+		onSampleRateChange();
+	}
+
+	void onSampleRateChange() override {
+		int sampleRate = APP->engine->getSampleRate();
+		outputSrc.prepare(48000, sampleRate);
+		outputSrc.prepare(48000, sampleRate, TIGHT_TAPS);
+	}
+
+	~Plaits() {
+		worker.wait();
+		for (int c = 0; c < 16; c++) {
+			delete voices[c].load();
+			delete retiredVoices[c].load();
+		}
+	}
+
+	/** Allocates voices up to the channel count the audio thread last saw, and frees the ones it has released.
+	Never call from process().
+	*/
+	void updateVoices() {
+		std::lock_guard<std::mutex> lock(voiceMutex);
+		int demand = voiceDemand.load();
+		for (int c = 0; c < 16; c++) {
+			delete retiredVoices[c].exchange(NULL);
+			if (c < demand && !voices[c].load())
+				voices[c].store(new PlaitsVoice);
+		}
+	}
+
+	/** Takes the audio thread's view of the voices for this block, and releases the ones above the channel count that have gone unused for a while.
+	The previous block must have been collected, so no task still holds a released voice.
+	*/
+	void takeVoices(int channels, float deltaTime) {
+		voiceDemand.store(channels, std::memory_order_relaxed);
+		for (int c = 0; c < 16; c++) {
+			PlaitsVoice* v = voices[c].load(std::memory_order_acquire);
+			if (v && c >= channels) {
+				voiceUnusedTime[c] += deltaTime;
+				// Only release once updateVoices() has freed the voice released before
+				if (voiceUnusedTime[c] >= VOICE_RELEASE_TIME && !retiredVoices[c].load()) {
+					voices[c].store(NULL);
+					retiredVoices[c].store(v, std::memory_order_release);
+					v = NULL;
+				}
+			}
+			else {
+				voiceUnusedTime[c] = 0.f;
+			}
+			voice[c] = v ? v->voice : NULL;
+		}
 	}
 
 	void onReset() override {
 		patch.engine = 0;
 		patch.lpg_colour = 0.5f;
 		patch.decay = 0.5f;
+		editVoice = -1;
+		clearVoiceKnobs();
+	}
+
+	static int getVoiceKnobParam(int i) {
+		const int ids[NUM_VOICE_KNOBS] = {HARMONICS_PARAM, TIMBRE_PARAM, MORPH_PARAM, LPG_COLOR_PARAM, LPG_DECAY_PARAM};
+		return ids[i];
+	}
+
+	/** Stores the panel knobs into the layer they were editing, and loads the layer of voice `v` (or -1 for all voices) into them. */
+	void setEditVoice(int v) {
+		if (v == editVoice)
+			return;
+		for (int i = 0; i < NUM_VOICE_KNOBS; i++) {
+			Param& param = params[getVoiceKnobParam(i)];
+			if (editVoice < 0)
+				sharedKnobs[i] = param.getValue();
+			else
+				voiceKnobs[editVoice][i] = param.getValue();
+		}
+		if (v >= 0 && !voiceKnobsSet[v]) {
+			// Start the new layer from the panel knobs
+			for (int i = 0; i < NUM_VOICE_KNOBS; i++)
+				voiceKnobs[v][i] = sharedKnobs[i];
+			voiceKnobsSet[v] = true;
+		}
+		for (int i = 0; i < NUM_VOICE_KNOBS; i++) {
+			params[getVoiceKnobParam(i)].setValue((v < 0) ? sharedKnobs[i] : voiceKnobs[v][i]);
+		}
+		editVoice = v;
+	}
+
+	/** Makes every voice follow the panel knobs again */
+	void clearVoiceKnobs() {
+		setEditVoice(-1);
+		for (int c = 0; c < 16; c++)
+			voiceKnobsSet[c] = false;
 	}
 
 	void onRandomize() override {
@@ -92,7 +266,36 @@ struct Plaits : Module {
 		json_t* rootJ = json_object();
 
 		json_object_set_new(rootJ, "lowCpu", json_boolean(lowCpu));
+		json_object_set_new(rootJ, "blockSize", json_integer(blockSize.load()));
+		json_object_set_new(rootJ, "tight", json_boolean(tight));
 		json_object_set_new(rootJ, "model", json_integer(patch.engine));
+		json_object_set_new(rootJ, "multithreaded", json_boolean(multithreaded));
+		json_object_set_new(rootJ, "voices", json_integer(voiceDemand.load()));
+
+		json_t* voiceKnobsJ = json_array();
+		for (int c = 0; c < 16; c++) {
+			if (!voiceKnobsSet[c]) {
+				json_array_append_new(voiceKnobsJ, json_null());
+				continue;
+			}
+			json_t* knobsJ = json_array();
+			for (int i = 0; i < NUM_VOICE_KNOBS; i++) {
+				// The voice being edited keeps its live values on the panel
+				float value = (c == editVoice) ? params[getVoiceKnobParam(i)].getValue() : voiceKnobs[c][i];
+				json_array_append_new(knobsJ, json_real(value));
+			}
+			json_array_append_new(voiceKnobsJ, knobsJ);
+		}
+		json_object_set_new(rootJ, "voiceKnobs", voiceKnobsJ);
+		if (editVoice >= 0) {
+			// The panel shows a voice's layer, so the param values saved with the patch aren't the shared knobs
+			json_t* sharedKnobsJ = json_array();
+			for (int i = 0; i < NUM_VOICE_KNOBS; i++)
+				json_array_append_new(sharedKnobsJ, json_real(sharedKnobs[i]));
+			json_object_set_new(rootJ, "sharedKnobs", sharedKnobsJ);
+		}
+
+		json_object_set_new(rootJ, "dspCost", dspCost.toJson());
 
 		return rootJ;
 	}
@@ -102,10 +305,54 @@ struct Plaits : Module {
 		if (lowCpuJ)
 			lowCpu = json_boolean_value(lowCpuJ);
 
+		json_t* blockSizeJ = json_object_get(rootJ, "blockSize");
+		if (blockSizeJ)
+			blockSize = clamp((int) json_integer_value(blockSizeJ), 1, MAX_BLOCK_SIZE);
+
+		json_t* tightJ = json_object_get(rootJ, "tight");
+		if (tightJ)
+			tight = json_boolean_value(tightJ);
+
 		json_t* modelJ = json_object_get(rootJ, "model");
 		if (modelJ)
 			patch.engine = json_integer_value(modelJ);
 
+		json_t* multithreadedJ = json_object_get(rootJ, "multithreaded");
+		if (multithreadedJ) {
+			multithreaded = json_boolean_value(multithreadedJ);
+			worker.setPooled(multithreaded);
+		}
+
+		// Allocate the patch's voices up front, so a polyphonic patch doesn't start with silent channels
+		json_t* voicesJ = json_object_get(rootJ, "voices");
+		if (voicesJ) {
+			voiceDemand = clamp((int) json_integer_value(voicesJ), 1, 16);
+			updateVoices();
+		}
+
+		json_t* voiceKnobsJ = json_object_get(rootJ, "voiceKnobs");
+		if (voiceKnobsJ) {
+			editVoice = -1;
+			for (int c = 0; c < 16; c++) {
+				json_t* knobsJ = json_array_get(voiceKnobsJ, c);
+				voiceKnobsSet[c] = json_is_array(knobsJ);
+				if (!voiceKnobsSet[c])
+					continue;
+				for (int i = 0; i < NUM_VOICE_KNOBS; i++)
+					voiceKnobs[c][i] = json_number_value(json_array_get(knobsJ, i));
+			}
+		}
+
+		json_t* sharedKnobsJ = json_object_get(rootJ, "sharedKnobs");
+		if (sharedKnobsJ) {
+			for (int i = 0; i < NUM_VOICE_KNOBS; i++)
+				params[getVoiceKnobParam(i)].setValue(json_number_value(json_array_get(sharedKnobsJ, i)));
+		}
+
+		json_t* dspCostJ = json_object_get(rootJ, "dspCost");
+		if (dspCostJ)
+			dspCost.fromJson(dspCostJ);
+
 		// Legacy <=1.0.2
 		json_t* lpgColorJ = json_object_get(rootJ, "lpgColor");
 		if (lpgColorJ)
@@ -121,7 +368,8 @@ struct Plaits : Module {
 		int channels = std::max(inputs[NOTE_INPUT].getChannels(), 1);
 
 		if (outputBuffer.empty()) {
-			const int blockSize = 12;
+			// The menu can change the block size at any time, so use one value for the whole block
+			int blockSize = this->blockSize.load();
 
 			// Model buttons
 			if (model1Trigger.process(params[MODEL1_PARAM].getValue())) {
@@ -141,95 +389,201 @@ struct Plaits : Module {
 				}
 			}
 
-			// Model lights
-			// Pulse light at 2 Hz
-			triPhase += 2.f * args.sampleTime * blockSize;
-			if (triPhase >= 1.f)
-				triPhase -= 1.f;
-			float tri = (triPhase < 0.5f) ? triPhase * 2.f : (1.f - triPhase) * 2.f;
-
-			// Get active engines of all voice channels
-			bool activeEngines[16] = {};
-			bool pulse = false;
-			for (int c = 0; c < channels; c++) {
-				int activeEngine = voice[c].active_engine();
-				activeEngines[activeEngine] = true;
-				// Pulse the light if at least one voice is using a different engine.
-				if (activeEngine != patch.engine)
-					pulse = true;
-			}
+			// Voices are only touched by one thread at a time, so wait for the previous block
+			worker.wait();
+			takeVoices(channels, blockSize * args.sampleTime);
+			dspCost.begin();
+
+			// Model lights, updated every LIGHT_DIVISION frames whatever the block size
+			lightDivider.setDivision(std::max(1, common::LIGHT_DIVISION / blockSize));
+			if (lightDivider.process()) {
+				// Pulse light at 2 Hz
+				triPhase += 2.f * args.sampleTime * blockSize * lightDivider.getDivision();
+				if (triPhase >= 1.f)
+					triPhase -= 1.f;
+				float tri = (triPhase < 0.5f) ? triPhase * 2.f : (1.f - triPhase) * 2.f;
+
+				// Get active engines of all voice channels
+				bool activeEngines[16] = {};
+				bool pulse = false;
+				for (int c = 0; c < channels; c++) {
+					if (!voice[c])
+						continue;
+					int activeEngine = voice[c]->active_engine();
+					activeEngines[activeEngine] = true;
+					// Pulse the light if at least one voice is using a different engine.
+					if (activeEngine != patch.engine)
+						pulse = true;
+				}
 
-			// Set model lights
-			for (int i = 0; i < 16; i++) {
-				// Transpose the [light][color] table
-				int lightId = (i % 8) * 2 + (i / 8);
-				float brightness = activeEngines[i];
-				if (patch.engine == i && pulse)
-					brightness = tri;
-				lights[MODEL_LIGHT + lightId].setBrightness(brightness);
+				// Set model lights
+				for (int i = 0; i < 16; i++) {
+					// Transpose the [light][color] table
+					int lightId = (i % 8) * 2 + (i / 8);
+					float brightness = activeEngines[i];
+					if (patch.engine == i && pulse)
+						brightness = tri;
+					lights[MODEL_LIGHT + lightId].setBrightness(brightness);
+				}
 			}
+			dspCost.lap(common::DspCost::LIGHTS);
 
+			// In lowCpu mode the engines run at the host rate while assuming 48 kHz, so everything timed in samples is off by this many octaves
+			float rateOctaves = lowCpu ? std::log2(48000.f * args.sampleTime) : 0.f;
 			// Calculate pitch for lowCpu mode if needed
-			float pitch = params[FREQ_PARAM].getValue();
-			if (lowCpu)
-				pitch += std::log2(48000.f * args.sampleTime);
+			float pitch = params[FREQ_PARAM].getValue() + rateOctaves;
 			// Update patch
 			patch.note = 60.f + pitch * 12.f;
-			patch.harmonics = params[HARMONICS_PARAM].getValue();
-			patch.timbre = params[TIMBRE_PARAM].getValue();
-			patch.morph = params[MORPH_PARAM].getValue();
-			patch.lpg_colour = params[LPG_COLOR_PARAM].getValue();
-			patch.decay = params[LPG_DECAY_PARAM].getValue();
 			patch.frequency_modulation_amount = params[FREQ_CV_PARAM].getValue();
 			patch.timbre_modulation_amount = params[TIMBRE_CV_PARAM].getValue();
 			patch.morph_modulation_amount = params[MORPH_CV_PARAM].getValue();
 
+			// The panel knobs edit either every voice or a single voice's layer
+			float knobs[NUM_VOICE_KNOBS];
+			for (int i = 0; i < NUM_VOICE_KNOBS; i++) {
+				float value = params[getVoiceKnobParam(i)].getValue();
+				if (editVoice >= 0) {
+					voiceKnobs[editVoice][i] = value;
+					value = sharedKnobs[i];
+				}
+				knobs[i] = value;
+			}
+			patch.harmonics = knobs[0];
+			patch.timbre = knobs[1];
+			patch.morph = knobs[2];
+			patch.lpg_colour = knobs[3];
+			patch.decay = knobs[4];
+
+			// Voices without a layer share the patch. Layered voices glide towards their own knobs.
+			float knobLambda = std::min(blockSize * args.sampleTime / VOICE_KNOB_SMOOTH_TIME, 1.f);
+			for (int c = 0; c < channels; c++) {
+				voicePatch[c] = patch;
+				if (!voiceKnobsSet[c]) {
+					std::memcpy(smoothedKnobs[c], knobs, sizeof(knobs));
+					continue;
+				}
+				float* smoothed = smoothedKnobs[c];
+				for (int i = 0; i < NUM_VOICE_KNOBS; i++)
+					smoothed[i] += (voiceKnobs[c][i] - smoothed[i]) * knobLambda;
+				voicePatch[c].harmonics = smoothed[0];
+				voicePatch[c].timbre = smoothed[1];
+				voicePatch[c].morph = smoothed[2];
+				voicePatch[c].lpg_colour = smoothed[3];
+				voicePatch[c].decay = smoothed[4];
+			}
+			if (lowCpu) {
+				// plaits/dsp/voice.cc sets the LPG's short decay to SemitonesToRatio(-96 * decay) per block, 8 octaves over the decay range.
+				// Shifting the setting by 1/8 per octave of rate keeps the short decay's time in seconds.
+				// This corrects the short decay only. The tail follows SemitonesToRatio(-72 * decay + 12 * lpg_colour), and matching it too would mean shifting the colour, which also changes the gate's tone.
+				for (int c = 0; c < channels; c++)
+					voicePatch[c].decay = clamp(voicePatch[c].decay - rateOctaves / 8.f, 0.f, 1.f);
+			}
+
 			// Render output buffer for each voice
-			dsp::Frame<16 * 2> outputFrames[blockSize];
+			dsp::Frame<16 * 2> outputFrames[MAX_BLOCK_SIZE];
+			// In multithreaded mode, the collected block may predate a change of block size
+			int frames = blockSize;
+			if (multithreaded && asyncChannels > 0)
+				frames = asyncBlockSize;
+			float blockTime = lowCpu ? frames * args.sampleTime : frames / 48000.f;
+			bool asleep = true;
+
+			// Construct modulations
+			plaits::Modulations voiceModulations[16];
+			// Every input but the note input is a modulation input
+			bool monophonic = true;
+			for (int i = 0; i < NOTE_INPUT; i++) {
+				if (inputs[i].getChannels() > 1)
+					monophonic = false;
+			}
+			if (monophonic) {
+				// Every voice gets the same modulations apart from its note, so build them once and broadcast them
+				buildModulations(voiceModulations[0], 0);
+				for (int c = 1; c < channels; c++) {
+					voiceModulations[c] = voiceModulations[0];
+					voiceModulations[c].note = inputs[NOTE_INPUT].getVoltage(c) * 12.f;
+				}
+			}
+			else {
+				for (int c = 0; c < channels; c++)
+					buildModulations(voiceModulations[c], c);
+			}
+
+			// Skip voices that have decayed to silence
+			bool voiceActive[16];
 			for (int c = 0; c < channels; c++) {
-				// Construct modulations
-				plaits::Modulations modulations;
-				modulations.engine = inputs[ENGINE_INPUT].getPolyVoltage(c) / 5.f;
-				modulations.note = inputs[NOTE_INPUT].getVoltage(c) * 12.f;
-				modulations.frequency = inputs[FREQ_INPUT].getPolyVoltage(c) * 6.f;
-				modulations.harmonics = inputs[HARMONICS_INPUT].getPolyVoltage(c) / 5.f;
-				modulations.timbre = inputs[TIMBRE_INPUT].getPolyVoltage(c) / 8.f;
-				modulations.morph = inputs[MORPH_INPUT].getPolyVoltage(c) / 8.f;
-				// Triggers at around 0.7 V
-				modulations.trigger = inputs[TRIGGER_INPUT].getPolyVoltage(c) / 3.f;
-				modulations.level = inputs[LEVEL_INPUT].getPolyVoltage(c) / 8.f;
-
-				modulations.frequency_patched = inputs[FREQ_INPUT].isConnected();
-				modulations.timbre_patched = inputs[TIMBRE_INPUT].isConnected();
-				modulations.morph_patched = inputs[MORPH_INPUT].isConnected();
-				modulations.trigger_patched = inputs[TRIGGER_INPUT].isConnected();
-				modulations.level_patched = inputs[LEVEL_INPUT].isConnected();
-
-				// Render frames
-				plaits::Voice::Frame output[blockSize];
-				voice[c].Render(patch, modulations, output, blockSize);
-
-				// Convert output to frames
-				for (int i = 0; i < blockSize; i++) {
-					outputFrames[i].samples[c * 2 + 0] = output[i].out / 32768.f;
-					outputFrames[i].samples[c * 2 + 1] = output[i].aux / 32768.f;
+				voiceActive[c] = !isVoiceIdle(c, voiceModulations[c]) && voice[c];
+			}
+
+			if (multithreaded) {
+				// Collect the previous block and hand this one to the workers
+				for (int c = 0; c < channels; c++) {
+					bool active = c < asyncChannels && asyncActive[c];
+					if (active)
+						asleep = false;
+					collectVoice(c, active ? asyncOutput[c] : NULL, outputFrames, frames, blockTime);
+				}
+				asyncChannels = channels;
+				asyncBlockSize = blockSize;
+				int numVoices = 0;
+				for (int c = 0; c < channels; c++) {
+					asyncPatch[c] = voicePatch[c];
+					asyncModulations[c] = voiceModulations[c];
+					asyncActive[c] = voiceActive[c];
+					if (voiceActive[c])
+						asyncVoices[numVoices++] = c;
 				}
+				worker.post(numVoices);
 			}
+			else {
+				asyncChannels = 0;
+				for (int c = 0; c < channels; c++) {
+					if (!voiceActive[c]) {
+						collectVoice(c, NULL, outputFrames, frames, blockTime);
+						continue;
+					}
+					asleep = false;
+
+					// Render frames
+					plaits::Voice::Frame output[MAX_BLOCK_SIZE];
+					voice[c]->Render(voicePatch[c], voiceModulations[c], output, frames);
+					collectVoice(c, output, outputFrames, frames, blockTime);
+				}
+			}
+			dspCost.lap(common::DspCost::DSP);
 
 			// Convert output
-			if (lowCpu) {
-				int len = std::min((int) outputBuffer.capacity(), blockSize);
+			outputSrc.setBaseTaps(tight ? TIGHT_TAPS : (int) common::ResamplerKernel::BASE_TAPS);
+			// Only convert the lanes of patched outputs
+			bool outConnected = outputs[OUT_OUTPUT].isConnected();
+			bool auxConnected = outputs[AUX_OUTPUT].isConnected();
+			for (int c = 0; c < channels; c++) {
+				outputSrc.setChannelEnabled(c * 2 + 0, outConnected);
+				outputSrc.setChannelEnabled(c * 2 + 1, auxConnected);
+			}
+			if (asleep && !lowCpu) {
+				// Every voice is silent, so only advance the converter
+				outputSrc.setRates(48000, (int) args.sampleRate);
+				outputSrc.setChannels(channels * 2);
+				int outLen = outputSrc.skip(frames, outputBuffer.capacity());
+				std::memset(outputBuffer.endData(), 0, outLen * sizeof(outputFrames[0]));
+				outputBuffer.endIncr(outLen);
+			}
+			else if (lowCpu) {
+				int len = std::min((int) outputBuffer.capacity(), frames);
 				std::memcpy(outputBuffer.endData(), outputFrames, len * sizeof(outputFrames[0]));
 				outputBuffer.endIncr(len);
 			}
 			else {
 				outputSrc.setRates(48000, (int) args.sampleRate);
-				int inLen = blockSize;
+				int inLen = frames;
 				int outLen = outputBuffer.capacity();
 				outputSrc.setChannels(channels * 2);
 				outputSrc.process(outputFrames, &inLen, outputBuffer.endData(), &outLen);
 				outputBuffer.endIncr(outLen);
 			}
+			dspCost.lap(common::DspCost::SRC);
+			dspCost.endBlock();
 		}
 
 		// Set output
@@ -244,6 +598,92 @@ struct Plaits : Module {
 		outputs[OUT_OUTPUT].setChannels(channels);
 		outputs[AUX_OUTPUT].setChannels(channels);
 	}
+
+	/** Converts a voice's rendered block into output frames and tracks its level. Pass NULL for a silent voice. */
+	void collectVoice(int c, const plaits::Voice::Frame* output, dsp::Frame<16 * 2>* outputFrames, int frames, float blockTime) {
+		if (!output) {
+			for (int i = 0; i < frames; i++) {
+				outputFrames[i].samples[c * 2 + 0] = 0.f;
+				outputFrames[i].samples[c * 2 + 1] = 0.f;
+			}
+			return;
+		}
+
+		int peak = 0;
+		for (int i = 0; i < frames; i++) {
+			outputFrames[i].samples[c * 2 + 0] = output[i].out / 32768.f;
+			outputFrames[i].samples[c * 2 + 1] = output[i].aux / 32768.f;
+			peak = std::max(peak, std::max(std::abs((int) output[i].out), std::abs((int) output[i].aux)));
+		}
+		idle[c].processOutput(peak / 32768.f, blockTime);
+	}
+
+	/** Scales channel c of the inputs into a voice's modulations */
+	void buildModulations(plaits::Modulations& modulations, int c) {
+		modulations.engine = inputs[ENGINE_INPUT].getPolyVoltage(c) / 5.f;
+		modulations.note = inputs[NOTE_INPUT].getVoltage(c) * 12.f;
+		modulations.frequency = inputs[FREQ_INPUT].getPolyVoltage(c) * 6.f;
+		modulations.harmonics = inputs[HARMONICS_INPUT].getPolyVoltage(c) / 5.f;
+		modulations.timbre = inputs[TIMBRE_INPUT].getPolyVoltage(c) / 8.f;
+		modulations.morph = inputs[MORPH_INPUT].getPolyVoltage(c) / 8.f;
+		// Triggers at around 0.7 V
+		modulations.trigger = inputs[TRIGGER_INPUT].getPolyVoltage(c) / 3.f;
+		modulations.level = inputs[LEVEL_INPUT].getPolyVoltage(c) / 8.f;
+
+		modulations.frequency_patched = inputs[FREQ_INPUT].isConnected();
+		modulations.timbre_patched = inputs[TIMBRE_INPUT].isConnected();
+		modulations.morph_patched = inputs[MORPH_INPUT].isConnected();
+		modulations.trigger_patched = inputs[TRIGGER_INPUT].isConnected();
+		modulations.level_patched = inputs[LEVEL_INPUT].isConnected();
+	}
+
+	bool isVoiceIdle(int c, const plaits::Modulations& modulations) {
+		common::IdleDetector& idle = this->idle[c];
+		idle.beginControls();
+
+		if (modulations.trigger_patched || modulations.level_patched) {
+			// The low-pass gate (or the percussive engines' own envelope) keeps the voice silent until it is triggered or its level opens.
+			// Other control changes can't make it sound, so only watch the gate inputs.
+			idle.pushControl(modulations.trigger_patched);
+			idle.pushControl(modulations.level_patched);
+			// Stay awake while the trigger or level input is anywhere above 0 V.
+			bool triggered = modulations.trigger_patched && modulations.trigger > 0.f;
+			bool opened = modulations.level_patched && modulations.level > 0.f;
+			// The gate's decay is rendered until the output is silent, so this short hold only guards against gaps within a tail.
+			idle.holdTime = LPG_TAIL_TIME;
+			return idle.isAsleep(triggered || opened);
+		}
+		idle.holdTime = 1.f;
+
+		const plaits::Patch& patch = voicePatch[c];
+		idle.pushControl(patch.engine);
+		idle.pushControl(patch.note);
+		idle.pushControl(patch.harmonics);
+		idle.pushControl(patch.timbre);
+		idle.pushControl(patch.morph);
+		idle.pushControl(patch.lpg_colour);
+		idle.pushControl(patch.decay);
+		idle.pushControl(patch.frequency_modulation_amount);
+		idle.pushControl(patch.timbre_modulation_amount);
+		idle.pushControl(patch.morph_modulation_amount);
+
+		idle.pushControl(modulations.engine);
+		idle.pushControl(modulations.note);
+		idle.pushControl(modulations.frequency);
+		idle.pushControl(modulations.harmonics);
+		idle.pushControl(modulations.timbre);
+		idle.pushControl(modulations.morph);
+		idle.pushControl(modulations.trigger);
+		idle.pushControl(modulations.level);
+		idle.pushControl(modulations.frequency_patched);
+		idle.pushControl(modulations.timbre_patched);
+		idle.pushControl(modulations.morph_patched);
+		idle.pushControl(modulations.trigger_patched);
+		idle.pushControl(modulations.level_patched);
+
+		// A voice is only excited by a change of its controls, including a trigger edge.
+		return idle.isAsleep(false);
+	}
 };
 
 
@@ -267,6 +707,13 @@ static const std::string modelLabels[16] = {
 };
 
 
+#ifdef BENCHMARK
+std::string getPlaitsModelLabel(int i) {
+	return modelLabels[i];
+}
+#endif
+
+
 struct PlaitsWidget : ModuleWidget {
 	bool lpgMode = false;
 
@@ -318,6 +765,13 @@ struct PlaitsWidget : ModuleWidget {
 		addChild(createLight<MediumLight<GreenRedLight>>(mm2px(Vec(28.79498, 61.11827)), module, Plaits::MODEL_LIGHT + 7 * 2));
 	}
 
+	void step() override {
+		Plaits* module = dynamic_cast<Plaits*>(this->module);
+		if (module)
+			module->updateVoices();
+		ModuleWidget::step();
+	}
+
 	void appendContextMenu(Menu* menu) override {
 		Plaits* module = dynamic_cast<Plaits*>(this->module);
 
@@ -328,6 +782,57 @@ struct PlaitsWidget : ModuleWidget {
 			}
 		};
 
+		struct PlaitsBlockSizeItem : MenuItem {
+			Plaits* module;
+			int blockSize;
+			void onAction(const event::Action& e) override {
+				module->blockSize = blockSize;
+			}
+		};
+
+		struct PlaitsTightItem : MenuItem {
+			Plaits* module;
+			void onAction(const event::Action& e) override {
+				module->tight ^= true;
+			}
+		};
+
+		struct PlaitsEditVoiceValueItem : MenuItem {
+			Plaits* module;
+			int voice;
+			void onAction(const event::Action& e) override {
+				module->setEditVoice(voice);
+			}
+		};
+
+		struct PlaitsEditVoiceItem : MenuItem {
+			Plaits* module;
+			Menu* createChildMenu() override {
+				Menu* menu = new Menu;
+				PlaitsEditVoiceValueItem* allItem = createMenuItem<PlaitsEditVoiceValueItem>("All voices", CHECKMARK(module->editVoice < 0));
+				allItem->module = module;
+				allItem->voice = -1;
+				menu->addChild(allItem);
+				for (int c = 0; c < 16; c++) {
+					std::string text = string::f("Voice %d", c + 1);
+					if (module->voiceKnobsSet[c])
+						text += " (own knobs)";
+					PlaitsEditVoiceValueItem* voiceItem = createMenuItem<PlaitsEditVoiceValueItem>(text, CHECKMARK(module->editVoice == c));
+					voiceItem->module = module;
+					voiceItem->voice = c;
+					menu->addChild(voiceItem);
+				}
+				return menu;
+			}
+		};
+
+		struct PlaitsClearVoiceKnobsItem : MenuItem {
+			Plaits* module;
+			void onAction(const event::Action& e) override {
+				module->clearVoiceKnobs();
+			}
+		};
+
 		struct PlaitsLpgModeItem : MenuItem {
 			PlaitsWidget* moduleWidget;
 			void onAction(const event::Action& e) override {
@@ -350,6 +855,26 @@ struct PlaitsWidget : ModuleWidget {
 		PlaitsLpgModeItem* lpgItem = createMenuItem<PlaitsLpgModeItem>("Edit LPG response/decay", CHECKMARK(getLpgMode()));
 		lpgItem->moduleWidget = this;
 		menu->addChild(lpgItem);
+		PlaitsEditVoiceItem* editVoiceItem = createMenuItem<PlaitsEditVoiceItem>("Knobs edit", RIGHT_ARROW);
+		editVoiceItem->module = module;
+		menu->addChild(editVoiceItem);
+		PlaitsClearVoiceKnobsItem* clearVoiceKnobsItem = createMenuItem<PlaitsClearVoiceKnobsItem>("Clear per-voice knobs");
+		clearVoiceKnobsItem->module = module;
+		menu->addChild(clearVoiceKnobsItem);
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createMenuLabel("Block size"));
+		const int blockSizes[] = {1, 4, 12, 24};
+		const char* blockSizeLabels[] = {"1 sample (lowest latency)", "4 samples", "12 samples", "24 samples (highest throughput)"};
+		for (int i = 0; i < 4; i++) {
+			PlaitsBlockSizeItem* blockSizeItem = createMenuItem<PlaitsBlockSizeItem>(blockSizeLabels[i], CHECKMARK(module->blockSize == blockSizes[i]));
+			blockSizeItem->module = module;
+			blockSizeItem->blockSize = blockSizes[i];
+			menu->addChild(blockSizeItem);
+		}
+		PlaitsTightItem* tightItem = createMenuItem<PlaitsTightItem>("Low-latency resampling", CHECKMARK(module->tight));
+		tightItem->module = module;
+		menu->addChild(tightItem);
 
 		menu->addChild(new MenuSeparator);
 		menu->addChild(createMenuLabel("Models"));
@@ -359,6 +884,9 @@ struct PlaitsWidget : ModuleWidget {
 			modelItem->model = i;
 			menu->addChild(modelItem);
 		}
+
+		common::appendMultithreadedMenu(menu, &module->multithreaded, &module->worker, "one block");
+		common::appendDspCostMenu(menu, &module->dspCost, {common::DspCost::DSP, common::DspCost::SRC, common::DspCost::LIGHTS});
 	}
 
 	void setLpgMode(bool lpgMode) {
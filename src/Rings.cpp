@@ -1,4 +1,9 @@
 #include "plugin.hpp"
+#include "common/dspcost.hpp"
+#include "common/resampler.hpp"
+#include "common/idle.hpp"
+#include "common/guard.hpp"
+#include "common/arena.hpp"
 #include "rings/dsp/part.h"
 #include "rings/dsp/strummer.h"
 #include "rings/dsp/string_synth_part.h"
@@ -45,14 +50,17 @@ struct Rings : Module {
 		NUM_LIGHTS
 	};
 
-	dsp::SampleRateConverter<1> inputSrc;
-	dsp::SampleRateConverter<2> outputSrc;
+	common::PolyphaseResampler<1> inputSrc;
+	common::PolyphaseResampler<2> outputSrc;
 	dsp::DoubleRingBuffer<dsp::Frame<1>, 256> inputBuffer;
 	dsp::DoubleRingBuffer<dsp::Frame<2>, 256> outputBuffer;
 
-	uint16_t reverb_buffer[32768] = {};
-	rings::Part part;
-	rings::StringSynthPart string_synth;
+	/** Holds both parts and their shared reverb buffer */
+	common::Arena arena;
+	static const int REVERB_SIZE = 32768;
+	uint16_t* reverb_buffer;
+	rings::Part* part;
+	rings::StringSynthPart* string_synth;
 	rings::Strummer strummer;
 	bool strum = false;
 	bool lastStrum = false;
@@ -63,6 +71,10 @@ struct Rings : Module {
 	rings::ResonatorModel resonatorModel = rings::RESONATOR_MODEL_MODAL;
 	bool easterEgg = false;
 
+	common::DspCost dspCost;
+	common::DspGuard dspGuard;
+	common::IdleDetector idle;
+
 	Rings() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		configParam(POLYPHONY_PARAM, 0.0, 1.0, 0.0, "Polyphony");
@@ -78,9 +90,31 @@ struct Rings : Module {
 		configParam(STRUCTURE_MOD_PARAM, -1.0, 1.0, 0.0, "Structure attenuverter");
 		configParam(POSITION_MOD_PARAM, -1.0, 1.0, 0.0, "Position attenuverter");
 
+		arena.reserve(common::Arena::footprint<rings::Part>() + common::Arena::footprint<rings::StringSynthPart>() + common::Arena::footprint<uint16_t>(REVERB_SIZE));
+		part = arena.create<rings::Part>();
+		string_synth = arena.create<rings::StringSynthPart>();
+		reverb_buffer = arena.alloc<uint16_t>(REVERB_SIZE);
+
 		strummer.Init(0.01, 44100.0 / 24);
-		part.Init(reverb_buffer);
-		string_synth.Init(reverb_buffer);
+		initEngines();
+		onSampleRateChange();
+	}
+
+	~Rings() {
+		string_synth->~StringSynthPart();
+		part->~Part();
+	}
+
+	void onSampleRateChange() override {
+		float sampleRate = APP->engine->getSampleRate();
+		inputSrc.prepare(sampleRate, 48000);
+		outputSrc.prepare(48000, sampleRate);
+	}
+
+	void initEngines() {
+		std::memset(reverb_buffer, 0, REVERB_SIZE * sizeof(uint16_t));
+		part->Init(reverb_buffer);
+		string_synth->Init(reverb_buffer);
 	}
 
 	void process(const ProcessArgs& args) override {
@@ -111,8 +145,19 @@ struct Rings : Module {
 		lights[RESONATOR_GREEN_LIGHT].value = (modelColor == 0 || modelColor == 1) ? 1.0 : 0.0;
 		lights[RESONATOR_RED_LIGHT].value = (modelColor == 1 || modelColor == 2) ? 1.0 : 0.0;
 
+		// Skip rendering while the resonator is silent and nothing excites it
+		if (outputBuffer.empty() && isIdle()) {
+			inputBuffer.clear();
+			outputSrc.setRates(48000, args.sampleRate);
+			int outLen = outputSrc.skip(24, outputBuffer.capacity());
+			std::memset(outputBuffer.endData(), 0, outLen * sizeof(dsp::Frame<2>));
+			outputBuffer.endIncr(outLen);
+		}
+
 		// Render frames
 		if (outputBuffer.empty()) {
+			dspCost.begin();
+
 			float in[24] = {};
 			// Convert input buffer
 			{
@@ -122,16 +167,17 @@ struct Rings : Module {
 				inputSrc.process(inputBuffer.startData(), &inLen, (dsp::Frame<1>*) in, &outLen);
 				inputBuffer.startIncr(inLen);
 			}
+			dspCost.lap(common::DspCost::SRC);
 
 			// Polyphony
 			int polyphony = 1 << polyphonyMode;
-			if (part.polyphony() != polyphony)
-				part.set_polyphony(polyphony);
+			if (part->polyphony() != polyphony)
+				part->set_polyphony(polyphony);
 			// Model
 			if (easterEgg)
-				string_synth.set_fx((rings::FxType) resonatorModel);
+				string_synth->set_fx((rings::FxType) resonatorModel);
 			else
-				part.set_model(resonatorModel);
+				part->set_model(resonatorModel);
 
 			// Patch
 			rings::Patch patch;
@@ -169,12 +215,21 @@ struct Rings : Module {
 			float aux[24];
 			if (easterEgg) {
 				strummer.Process(NULL, 24, &performance_state);
-				string_synth.Process(performance_state, patch, in, out, aux, 24);
+				string_synth->Process(performance_state, patch, in, out, aux, 24);
 			}
 			else {
 				strummer.Process(in, 24, &performance_state);
-				part.Process(performance_state, patch, in, out, aux, 24);
+				part->Process(performance_state, patch, in, out, aux, 24);
 			}
+			if (dspGuard.check(out, 24) || dspGuard.check(aux, 24)) {
+				initEngines();
+				std::memset(out, 0, sizeof(out));
+				std::memset(aux, 0, sizeof(aux));
+			}
+			dspCost.lap(common::DspCost::DSP);
+
+			float peak = std::max(common::IdleDetector::getPeak(out, 24), common::IdleDetector::getPeak(aux, 24));
+			idle.processOutput(peak, 24 / 48000.f);
 
 			// Convert output buffer
 			{
@@ -190,6 +245,8 @@ struct Rings : Module {
 				outputSrc.process(outputFrames, &inLen, outputBuffer.endData(), &outLen);
 				outputBuffer.endIncr(outLen);
 			}
+			dspCost.lap(common::DspCost::SRC);
+			dspCost.endBlock();
 		}
 
 		// Set output
@@ -208,12 +265,26 @@ struct Rings : Module {
 		}
 	}
 
+	bool isIdle() {
+		idle.beginControls();
+		idle.pushModuleControls(this);
+		idle.pushControl(polyphonyMode);
+		idle.pushControl(resonatorModel);
+		idle.pushControl(easterEgg);
+
+		float inputPeak = common::IdleDetector::getPeak((const float*) inputBuffer.startData(), inputBuffer.size());
+		bool excited = strum || inputPeak >= common::IdleDetector::SILENCE;
+		return idle.isAsleep(excited);
+	}
+
 	json_t* dataToJson() override {
 		json_t* rootJ = json_object();
 
 		json_object_set_new(rootJ, "polyphony", json_integer(polyphonyMode));
 		json_object_set_new(rootJ, "model", json_integer((int) resonatorModel));
 		json_object_set_new(rootJ, "easterEgg", json_boolean(easterEgg));
+		json_object_set_new(rootJ, "dspCost", dspCost.toJson());
+		json_object_set_new(rootJ, "dspGuard", dspGuard.toJson());
 
 		return rootJ;
 	}
@@ -233,6 +304,16 @@ struct Rings : Module {
 		if (easterEggJ) {
 			easterEgg = json_boolean_value(easterEggJ);
 		}
+
+		json_t* dspCostJ = json_object_get(rootJ, "dspCost");
+		if (dspCostJ) {
+			dspCost.fromJson(dspCostJ);
+		}
+
+		json_t* dspGuardJ = json_object_get(rootJ, "dspGuard");
+		if (dspGuardJ) {
+			dspGuard.fromJson(dspGuardJ);
+		}
 	}
 
 	void onReset() override {
@@ -327,6 +408,9 @@ struct RingsWidget : ModuleWidget {
 
 		menu->addChild(new MenuSeparator);
 		menu->addChild(construct<RingsEasterEggItem>(&MenuItem::text, "Disastrous Peace", &RingsEasterEggItem::rings, rings));
+
+		common::appendDspGuardMenu(menu, &rings->dspGuard);
+		common::appendDspCostMenu(menu, &rings->dspCost, {common::DspCost::DSP, common::DspCost::SRC});
 	}
 };
 
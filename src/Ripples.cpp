@@ -1,5 +1,7 @@
 #include "plugin.hpp"
 #include "Ripples/ripples.hpp"
+#include "common/dspcost.hpp"
+#include "common/guard.hpp"
 
 
 struct Ripples : Module {
@@ -29,6 +31,8 @@ struct Ripples : Module {
 	};
 
 	ripples::RipplesEngine engines[16];
+	common::DspCost dspCost;
+	common::DspGuard dspGuard;
 
 	Ripples() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -60,6 +64,7 @@ struct Ripples : Module {
 		frame.fm_knob = params[FM_PARAM].getValue();
 		frame.gain_cv_present = inputs[GAIN_INPUT].isConnected();
 
+		dspCost.begin();
 		for (int c = 0; c < channels; c++) {
 			frame.res_cv = inputs[RES_INPUT].getPolyVoltage(c);
 			frame.freq_cv = inputs[FREQ_INPUT].getPolyVoltage(c);
@@ -69,17 +74,42 @@ struct Ripples : Module {
 
 			engines[c].process(frame);
 
+			float out[4] = {frame.bp2, frame.lp2, frame.lp4, frame.lp4vca};
+			if (dspGuard.check(out, 4)) {
+				engines[c].reset();
+				frame.bp2 = frame.lp2 = frame.lp4 = frame.lp4vca = 0.f;
+			}
+
 			outputs[BP2_OUTPUT].setVoltage(frame.bp2, c);
 			outputs[LP2_OUTPUT].setVoltage(frame.lp2, c);
 			outputs[LP4_OUTPUT].setVoltage(frame.lp4, c);
 			outputs[LP4VCA_OUTPUT].setVoltage(frame.lp4vca, c);
 		}
+		dspCost.lap(common::DspCost::DSP);
+		dspCost.endBlock();
 
 		outputs[BP2_OUTPUT].setChannels(channels);
 		outputs[LP2_OUTPUT].setChannels(channels);
 		outputs[LP4_OUTPUT].setChannels(channels);
 		outputs[LP4VCA_OUTPUT].setChannels(channels);
 	}
+
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
+		json_object_set_new(rootJ, "dspCost", dspCost.toJson());
+		json_object_set_new(rootJ, "dspGuard", dspGuard.toJson());
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override {
+		json_t* dspCostJ = json_object_get(rootJ, "dspCost");
+		if (dspCostJ)
+			dspCost.fromJson(dspCostJ);
+
+		json_t* dspGuardJ = json_object_get(rootJ, "dspGuard");
+		if (dspGuardJ)
+			dspGuard.fromJson(dspGuardJ);
+	}
 };
 
 
@@ -106,6 +136,14 @@ struct RipplesWidget : ModuleWidget {
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(20.297, 111.05)), module, Ripples::LP4_OUTPUT));
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(32.367, 111.05)), module, Ripples::LP4VCA_OUTPUT));
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		Ripples* module = dynamic_cast<Ripples*>(this->module);
+		assert(module);
+
+		common::appendDspGuardMenu(menu, &module->dspGuard);
+		common::appendDspCostMenu(menu, &module->dspCost, {common::DspCost::DSP});
+	}
 };
 
 
@@ -148,6 +148,8 @@ public:
         cell_voltage_ = 0.f;
 
         aa_filter_.Init(sample_rate);
+        rc_filters_.reset();
+        vca_hpf_.reset();
 
         float oversample_rate =
             sample_rate * aa_filter_.GetOversamplingFactor();
@@ -164,6 +166,16 @@ public:
         vca_hpf_.setCutoffFreq(vca_cut / oversample_rate);
     }
 
+    // Clears the engine's state without redesigning its filters, so it is
+    // safe to call from the audio thread
+    void reset()
+    {
+        cell_voltage_ = 0.f;
+        aa_filter_.Reset();
+        rc_filters_.reset();
+        vca_hpf_.reset();
+    }
+
     void process(Frame& frame)
     {
         // Calculate equivalent frequency CV
@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "common/lights.hpp"
 
 
 struct Shades : Module {
@@ -30,6 +31,9 @@ struct Shades : Module {
 		NUM_LIGHTS
 	};
 
+	common::LightPeak outPeaks[3];
+	dsp::ClockDivider lightDivider;
+
 	Shades() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		configParam(GAIN1_PARAM, 0.0, 1.0, 0.5, "Gain 1");
@@ -38,6 +42,7 @@ struct Shades : Module {
 		configParam(MODE1_PARAM, 0.0, 1.0, 1.0, "Attenuverter/Attenuator mode 1");
 		configParam(MODE2_PARAM, 0.0, 1.0, 1.0, "Attenuverter/Attenuator mode 2");
 		configParam(MODE3_PARAM, 0.0, 1.0, 1.0, "Attenuverter/Attenuator mode 3");
+		lightDivider.setDivision(common::LIGHT_DIVISION);
 	}
 
 	void process(const ProcessArgs& args) override {
@@ -54,13 +59,19 @@ struct Shades : Module {
 				in *= params[GAIN1_PARAM + i].getValue();
 			}
 			out += in;
-			lights[OUT1_POS_LIGHT + 2 * i].setSmoothBrightness(fmaxf(0.0, out / 5.0), args.sampleTime);
-			lights[OUT1_NEG_LIGHT + 2 * i].setSmoothBrightness(fmaxf(0.0, -out / 5.0), args.sampleTime);
+			outPeaks[i].process(out);
 			if (outputs[OUT1_OUTPUT + i].isConnected()) {
 				outputs[OUT1_OUTPUT + i].setVoltage(out);
 				out = 0.0;
 			}
 		}
+
+		if (lightDivider.process()) {
+			float deltaTime = args.sampleTime * lightDivider.getDivision();
+			for (int i = 0; i < 3; i++) {
+				outPeaks[i].setLights(&lights[OUT1_POS_LIGHT + 2 * i], 1 / 5.f, deltaTime);
+			}
+		}
 	}
 };
 
@@ -1,5 +1,8 @@
 #include "plugin.hpp"
 #include "Shelves/shelves.hpp"
+#include "common/dspcost.hpp"
+#include "common/guard.hpp"
+#include "common/lights.hpp"
 
 
 static const float freqMin = std::log2(shelves::kFreqKnobMin);
@@ -59,9 +62,14 @@ struct Shelves : Module {
 
 	shelves::ShelvesEngine engines[16];
 	bool preGain;
+	common::DspCost dspCost;
+	common::DspGuard dspGuard;
+	common::LightPeak clipPeak;
+	dsp::ClockDivider lightDivider;
 
 	Shelves() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		lightDivider.setDivision(common::LIGHT_DIVISION);
 
 		configParam(HS_FREQ_PARAM, freqMin, freqMax, freqInit, "High-shelf frequency", " Hz", 2.f);
 		configParam(P1_FREQ_PARAM, freqMin, freqMax, freqInit, "Parametric 1 frequency", " Hz", 2.f);
@@ -133,6 +141,7 @@ struct Shelves : Module {
 
 		float clipLight = 0.f;
 
+		dspCost.begin();
 		for (int c = 0; c < channels; c++) {
 			frame.main_in = inputs[IN_INPUT].getVoltage(c);
 			frame.hs_freq_cv = inputs[HS_FREQ_INPUT].getPolyVoltage(c);
@@ -150,6 +159,14 @@ struct Shelves : Module {
 
 			engines[c].process(frame);
 
+			float out[7] = {frame.p1_hp_out, frame.p1_bp_out, frame.p1_lp_out, frame.p2_hp_out, frame.p2_bp_out, frame.p2_lp_out, frame.main_out};
+			if (dspGuard.check(out, 7)) {
+				engines[c].reset();
+				frame.p1_hp_out = frame.p1_bp_out = frame.p1_lp_out = 0.f;
+				frame.p2_hp_out = frame.p2_bp_out = frame.p2_lp_out = 0.f;
+				frame.main_out = 0.f;
+			}
+
 			outputs[P1_HP_OUTPUT].setVoltage(frame.p1_hp_out, c);
 			outputs[P1_BP_OUTPUT].setVoltage(frame.p1_bp_out, c);
 			outputs[P1_LP_OUTPUT].setVoltage(frame.p1_lp_out, c);
@@ -159,6 +176,7 @@ struct Shelves : Module {
 			outputs[OUT_OUTPUT].setVoltage(frame.main_out, c);
 			clipLight += frame.clip;
 		}
+		dspCost.lap(common::DspCost::DSP);
 
 		outputs[P1_HP_OUTPUT].setChannels(channels);
 		outputs[P1_BP_OUTPUT].setChannels(channels);
@@ -167,12 +185,19 @@ struct Shelves : Module {
 		outputs[P2_BP_OUTPUT].setChannels(channels);
 		outputs[P2_LP_OUTPUT].setChannels(channels);
 		outputs[OUT_OUTPUT].setChannels(channels);
-		lights[CLIP_LIGHT].setSmoothBrightness(clipLight, args.sampleTime);
+		clipPeak.process(clipLight);
+		if (lightDivider.process()) {
+			clipPeak.setLight(&lights[CLIP_LIGHT], 1.f, args.sampleTime * lightDivider.getDivision());
+		}
+		dspCost.lap(common::DspCost::LIGHTS);
+		dspCost.endBlock();
 	}
 
 	json_t* dataToJson() override {
 		json_t* root_j = json_object();
 		json_object_set_new(root_j, "preGain", json_boolean(preGain));
+		json_object_set_new(root_j, "dspCost", dspCost.toJson());
+		json_object_set_new(root_j, "dspGuard", dspGuard.toJson());
 		return root_j;
 	}
 
@@ -180,6 +205,14 @@ struct Shelves : Module {
 		json_t* preGainJ = json_object_get(root_j, "preGain");
 		if (preGainJ)
 			preGain = json_boolean_value(preGainJ);
+
+		json_t* dspCostJ = json_object_get(root_j, "dspCost");
+		if (dspCostJ)
+			dspCost.fromJson(dspCostJ);
+
+		json_t* dspGuardJ = json_object_get(root_j, "dspGuard");
+		if (dspGuardJ)
+			dspGuard.fromJson(dspGuardJ);
 	}
 };
 
@@ -232,6 +265,7 @@ struct ShelvesWidget : ModuleWidget {
 
 	void appendContextMenu(Menu* menu) override {
 		Shelves* module = dynamic_cast<Shelves*>(this->module);
+		assert(module);
 
 		menu->addChild(new MenuSeparator);
 
@@ -245,6 +279,9 @@ struct ShelvesWidget : ModuleWidget {
 		PreGainItem* preGainItem = createMenuItem<PreGainItem>("Pad input by -6dB", CHECKMARK(module->preGain));
 		preGainItem->module = module;
 		menu->addChild(preGainItem);
+
+		common::appendDspGuardMenu(menu, &module->dspGuard);
+		common::appendDspCostMenu(menu, &module->dspCost, {common::DspCost::DSP, common::DspCost::LIGHTS});
 	}
 };
 
@@ -310,6 +310,25 @@ public:
         clip_slew_.setRiseFall(rise, fall);
     }
 
+    // Clears the engine's state without redesigning its filters, so it is
+    // safe to call from the audio thread
+    void reset()
+    {
+        up_filter_[0].Reset();
+        up_filter_[1].Reset();
+        up_filter_[2].Reset();
+        down_filter_[0].Reset();
+        down_filter_[1].Reset();
+
+        low_high_.Init();
+        mid_.Init();
+
+        freq_lpf_.reset();
+        q_lpf_.reset();
+        clip_hpf_.reset();
+        clip_slew_.reset();
+    }
+
     void process(Frame& frame)
     {
         auto f_knob = simd::float_4(
@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "common/lights.hpp"
 #include "stages/segment_generator.h"
 #include "stages/oscillator.h"
 
@@ -153,8 +154,12 @@ struct Stages : Module {
 	int blockIndex = 0;
 	GroupBuilder groupBuilder;
 
+	common::LightPeak envelopePeaks[NUM_CHANNELS];
+	dsp::ClockDivider lightDivider;
+
 	Stages() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		lightDivider.setDivision(common::LIGHT_DIVISION);
 		configParam(SHAPE_PARAMS + 0, 0.0, 1.0, 0.5, "Shape 1");
 		configParam(SHAPE_PARAMS + 1, 0.0, 1.0, 0.5, "Shape 2");
 		configParam(SHAPE_PARAMS + 2, 0.0, 1.0, 0.5, "Shape 3");
@@ -359,33 +364,45 @@ struct Stages : Module {
 		}
 
 		// Output
-		for (int i = 0; i < groupBuilder.groupCount; i++) {
-			GroupInfo& group = groupBuilder.groups[i];
+		for (int segment = 0; segment < NUM_CHANNELS; segment++) {
+			float envelope = envelopeBuffer[segment][blockIndex];
+			outputs[ENVELOPE_OUTPUTS + segment].setVoltage(envelope * 8.f);
+			envelopePeaks[segment].process(envelope);
+		}
 
-			int numberOfLoopsInGroup = 0;
-			for (int j = 0; j < group.segment_count; j++) {
-				int segment = group.first_segment + j;
+		// Lights
+		if (lightDivider.process()) {
+			float deltaTime = args.sampleTime * lightDivider.getDivision();
 
-				float envelope = envelopeBuffer[segment][blockIndex];
-				outputs[ENVELOPE_OUTPUTS + segment].setVoltage(envelope * 8.f);
-				lights[ENVELOPE_LIGHTS + segment].setSmoothBrightness(envelope, args.sampleTime);
+			// Both flash phases are shared by every looping segment
+			float flash = std::fabs(std::sin(2.0f * M_PI * lightOscillatorPhase));
+			float advancedPhase = lightOscillatorPhase + 0.25f;
+			if (advancedPhase > 1.0f)
+				advancedPhase -= 1.0f;
+			float advancedFlash = std::fabs(std::sin(2.0f * M_PI * advancedPhase));
 
-				numberOfLoopsInGroup += configurations[segment].loop ? 1 : 0;
-				float flashlevel = 1.f;
+			for (int i = 0; i < groupBuilder.groupCount; i++) {
+				GroupInfo& group = groupBuilder.groups[i];
 
-				if (configurations[segment].loop && numberOfLoopsInGroup == 1) {
-					flashlevel = abs(sinf(2.0f * M_PI * lightOscillatorPhase));
-				}
-				else if (configurations[segment].loop && numberOfLoopsInGroup > 1) {
-					float advancedPhase = lightOscillatorPhase + 0.25f;
-					if (advancedPhase > 1.0f)
-						advancedPhase -= 1.0f;
+				int numberOfLoopsInGroup = 0;
+				for (int j = 0; j < group.segment_count; j++) {
+					int segment = group.first_segment + j;
 
-					flashlevel = abs(sinf(2.0f * M_PI * advancedPhase));
-				}
+					envelopePeaks[segment].setLight(&lights[ENVELOPE_LIGHTS + segment], 1.f, deltaTime);
+
+					numberOfLoopsInGroup += configurations[segment].loop ? 1 : 0;
+					float flashlevel = 1.f;
 
-				lights[TYPE_LIGHTS + segment * 2 + 0].setBrightness((configurations[segment].type == 0 || configurations[segment].type == 1) * flashlevel);
-				lights[TYPE_LIGHTS + segment * 2 + 1].setBrightness((configurations[segment].type == 1 || configurations[segment].type == 2) * flashlevel);
+					if (configurations[segment].loop && numberOfLoopsInGroup == 1) {
+						flashlevel = flash;
+					}
+					else if (configurations[segment].loop && numberOfLoopsInGroup > 1) {
+						flashlevel = advancedFlash;
+					}
+
+					lights[TYPE_LIGHTS + segment * 2 + 0].setBrightness((configurations[segment].type == 0 || configurations[segment].type == 1) * flashlevel);
+					lights[TYPE_LIGHTS + segment * 2 + 1].setBrightness((configurations[segment].type == 1 || configurations[segment].type == 2) * flashlevel);
+				}
 			}
 		}
 	}
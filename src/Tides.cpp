@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "common/lights.hpp"
 #include "tides/generator.h"
 
 
@@ -49,9 +50,12 @@ struct Tides : Module {
 	uint8_t lastGate;
 	dsp::SchmittTrigger modeTrigger;
 	dsp::SchmittTrigger rangeTrigger;
+	common::LightPeak phasePeak;
+	dsp::ClockDivider lightDivider;
 
 	Tides() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		lightDivider.setDivision(common::LIGHT_DIVISION);
 		configParam(MODE_PARAM, 0.0, 1.0, 0.0, "Output mode");
 		configParam(RANGE_PARAM, 0.0, 1.0, 0.0, "Frequency range");
 		configParam(FREQUENCY_PARAM, -48.0, 48.0, 0.0, "Main frequency");
@@ -149,8 +153,10 @@ struct Tides : Module {
 
 		if (sample.flags & tides::FLAG_END_OF_ATTACK)
 			unif *= -1.0;
-		lights[PHASE_GREEN_LIGHT].setSmoothBrightness(fmaxf(0.0, unif), args.sampleTime);
-		lights[PHASE_RED_LIGHT].setSmoothBrightness(fmaxf(0.0, -unif), args.sampleTime);
+		phasePeak.process(unif);
+		if (lightDivider.process()) {
+			phasePeak.setLights(&lights[PHASE_GREEN_LIGHT], 1.f, args.sampleTime * lightDivider.getDivision());
+		}
 	}
 
 	void onReset() override {
@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "common/lights.hpp"
 #include "stmlib/dsp/hysteresis_quantizer.h"
 #include "stmlib/dsp/units.h"
 #include "tides2/poly_slope_generator.h"
@@ -99,8 +100,12 @@ struct Tides2 : Module {
 	tides2::OutputMode previous_output_mode = tides2::OUTPUT_MODE_GATES;
 	uint8_t frame = 0;
 
+	common::LightPeak outputPeaks[4];
+	dsp::ClockDivider lightDivider;
+
 	Tides2() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+		lightDivider.setDivision(common::LIGHT_DIVISION);
 		configParam(RANGE_PARAM, 0.0, 1.0, 0.0, "Frequency range");
 		configParam(MODE_PARAM, 0.0, 1.0, 0.0, "Output mode");
 		configParam(FREQUENCY_PARAM, -48, 48, 0.0, "Ramp mode");
@@ -251,7 +256,13 @@ struct Tides2 : Module {
 		for (int i = 0; i < 4; i++) {
 			float value = out[frame].channel[i];
 			outputs[OUT_OUTPUTS + i].setVoltage(value);
-			lights[OUTPUT_LIGHTS + i].setSmoothBrightness(value, args.sampleTime);
+			outputPeaks[i].process(value);
+		}
+		if (lightDivider.process()) {
+			float deltaTime = args.sampleTime * lightDivider.getDivision();
+			for (int i = 0; i < 4; i++) {
+				outputPeaks[i].setLight(&lights[OUTPUT_LIGHTS + i], 1.f, deltaTime);
+			}
 		}
 	}
 };
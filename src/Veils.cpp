@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "common/lights.hpp"
 
 
 struct Veils : Module {
@@ -39,6 +40,9 @@ struct Veils : Module {
 		NUM_LIGHTS
 	};
 
+	common::LightPeak outPeaks[4];
+	dsp::ClockDivider lightDivider;
+
 	Veils() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
 		configParam(GAIN1_PARAM, 0.0, 1.0, 0.0, "Gain 1");
@@ -49,6 +53,7 @@ struct Veils : Module {
 		configParam(RESPONSE2_PARAM, 0.0, 1.0, 1.0, "Response curve 2");
 		configParam(RESPONSE3_PARAM, 0.0, 1.0, 1.0, "Response curve 3");
 		configParam(RESPONSE4_PARAM, 0.0, 1.0, 1.0, "Response curve 4");
+		lightDivider.setDivision(common::LIGHT_DIVISION);
 	}
 
 	void process(const ProcessArgs& args) override {
@@ -64,13 +69,19 @@ struct Veils : Module {
 				in *= crossfade(exponential, linear, params[RESPONSE1_PARAM + i].getValue());
 			}
 			out += in;
-			lights[OUT1_POS_LIGHT + 2 * i].setSmoothBrightness(fmaxf(0.0, out / 5.0), args.sampleTime);
-			lights[OUT1_NEG_LIGHT + 2 * i].setSmoothBrightness(fmaxf(0.0, -out / 5.0), args.sampleTime);
+			outPeaks[i].process(out);
 			if (outputs[OUT1_OUTPUT + i].isConnected()) {
 				outputs[OUT1_OUTPUT + i].setVoltage(out);
 				out = 0.0;
 			}
 		}
+
+		if (lightDivider.process()) {
+			float deltaTime = args.sampleTime * lightDivider.getDivision();
+			for (int i = 0; i < 4; i++) {
+				outPeaks[i].setLights(&lights[OUT1_POS_LIGHT + 2 * i], 1 / 5.f, deltaTime);
+			}
+		}
 	}
 };
 
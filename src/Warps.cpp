@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "common/dspcost.hpp"
 #include "warps/dsp/modulator.h"
 
 
@@ -37,6 +38,7 @@ struct Warps : Module {
 	warps::ShortFrame inputFrames[60] = {};
 	warps::ShortFrame outputFrames[60] = {};
 	dsp::SchmittTrigger stateTrigger;
+	common::DspCost dspCost;
 
 	Warps() {
 		config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -84,7 +86,10 @@ struct Warps : Module {
 			p->note = 60.0 * params[LEVEL1_PARAM].getValue() + 12.0 * inputs[LEVEL1_INPUT].getNormalVoltage(2.0) + 12.0;
 			p->note += log2f(96000.0f * args.sampleTime) * 12.0f;
 
+			dspCost.begin();
 			modulator.Process(inputFrames, outputFrames, 60);
+			dspCost.lap(common::DspCost::DSP);
+			dspCost.endBlock();
 		}
 
 		inputFrames[frame].l = clamp((int)(inputs[CARRIER_INPUT].getVoltage() / 16.0 * 0x8000), -0x8000, 0x7fff);
@@ -97,6 +102,7 @@ struct Warps : Module {
 		json_t* rootJ = json_object();
 		warps::Parameters* p = modulator.mutable_parameters();
 		json_object_set_new(rootJ, "shape", json_integer(p->carrier_shape));
+		json_object_set_new(rootJ, "dspCost", dspCost.toJson());
 		return rootJ;
 	}
 
@@ -106,6 +112,11 @@ struct Warps : Module {
 		if (shapeJ) {
 			p->carrier_shape = json_integer_value(shapeJ);
 		}
+
+		json_t* dspCostJ = json_object_get(rootJ, "dspCost");
+		if (dspCostJ) {
+			dspCost.fromJson(dspCostJ);
+		}
 	}
 
 	void onReset() override {
@@ -158,6 +169,13 @@ struct WarpsWidget : ModuleWidget {
 
 		addChild(createLight<AlgorithmLight>(Vec(40, 63), module, Warps::ALGORITHM_LIGHT));
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		Warps* warps = dynamic_cast<Warps*>(module);
+		assert(warps);
+
+		common::appendDspCostMenu(menu, &warps->dspCost, {common::DspCost::DSP});
+	}
 };
 
 
@@ -0,0 +1,471 @@
+#include "../plugin.hpp"
+#include "stmlib/utils/random.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <algorithm>
+#include <xmmintrin.h>
+
+
+// Offline benchmark harness.
+// Build the plugin with `make BENCHMARK=1` and launch Rack headless (`Rack -h`).
+// Once the engine exists, every model registered in plugin.cpp is instantiated outside of the engine, driven with scripted CV and audio, and timed block by block.
+// Modules never see a real patch, so the engine itself only supplies the sample rate.
+// The report is written to the log and to AudibleInstruments-benchmark.txt in the Rack user folder.
+//
+// The same build also runs a golden-output regression pass.
+// Each golden case renders a fixed stimulus with a fixed random seed and compares it against its reference in src/benchmark/golden.json.
+// A reference holds a hash of the output, its RMS envelope and its cost. Cases without one are reported as unrecorded, never recorded on the fly.
+// Build with `make BENCHMARK=1 GOLDEN_RECORD=1` to write a new golden.json to the Rack user folder instead, then review and commit it.
+
+
+namespace benchmark {
+
+
+/** Frames per timed block, Rack's default audio buffer size */
+static const int BLOCK_FRAMES = 256;
+/** Seconds of audio rendered per case */
+static const float DURATION = 4.f;
+/** Seconds of audio rendered per golden case */
+static const float GOLDEN_DURATION = 1.f;
+/** Frames per point of a golden RMS envelope */
+static const int GOLDEN_ENVELOPE_FRAMES = 256;
+/** Largest accepted RMS difference from the reference envelope, relative to the envelope's RMS level */
+static const double GOLDEN_TOLERANCE_DB = -60.0;
+/** Largest accepted cost relative to the cost recorded with the reference */
+static const double GOLDEN_BUDGET = 1.5;
+/** Seconds of audio rendered per cell of the Plaits engine table */
+static const float PLAITS_DURATION = 0.5f;
+
+
+struct Mode {
+	std::string name;
+	/** JSON passed to Module::dataFromJson() before rendering, or empty */
+	std::string data;
+};
+
+
+struct Case {
+	Model* model;
+	Mode mode;
+	float sampleRate;
+	int channels;
+};
+
+
+struct Result {
+	double nsPerSample = 0.0;
+	double meanBlockNs = 0.0;
+	double peakBlockNs = 0.0;
+	double p99BlockNs = 0.0;
+};
+
+
+/** Returns the settings which change the DSP path of a model. */
+static std::vector<Mode> getModes(Model* model) {
+	std::vector<Mode> modes;
+	if (model->slug == "Plaits") {
+		for (int i = 0; i < 16; i++)
+			modes.push_back({string::f("engine %d", i), string::f("{\"model\": %d}", i)});
+	}
+	else if (model->slug == "Clouds") {
+		static const char* playbackNames[] = {"granular", "stretch", "looping delay", "spectral"};
+		for (int i = 0; i < 4; i++)
+			modes.push_back({playbackNames[i], string::f("{\"playback\": %d}", i)});
+	}
+	else if (model->slug == "Rings") {
+		static const char* modelNames[] = {"modal", "sympathetic", "string", "fm voice", "sympathetic quantized", "string and reverb"};
+		for (int i = 0; i < 6; i++)
+			modes.push_back({modelNames[i], string::f("{\"model\": %d}", i)});
+	}
+	else if (model->slug == "Elements") {
+		static const char* modelNames[] = {"original", "non-linear string", "chords"};
+		for (int i = 0; i < 3; i++)
+			modes.push_back({modelNames[i], string::f("{\"model\": %d}", i)});
+	}
+	else {
+		modes.push_back({"default", ""});
+	}
+	return modes;
+}
+
+
+static bool isPolyphonic(Model* model) {
+	int polyphonicId = tag::findId("Polyphonic");
+	return std::find(model->tags.begin(), model->tags.end(), polyphonicId) != model->tags.end();
+}
+
+
+/** Scripted input voltage.
+Even inputs carry audio-rate sines, odd inputs carry slow gates so that triggers, clocks, and strums fire regularly.
+*/
+static float getStimulus(int input, int channel, int64_t frame, float sampleTime) {
+	double t = frame * sampleTime;
+	if (input % 2 == 0) {
+		double freq = 110.0 * (1 + input / 2) * (1.0 + 0.01 * channel);
+		return std::sin(2 * M_PI * freq * t);
+	}
+	double phase = t * (2.0 + 0.25 * input) + 0.1 * channel;
+	return (phase - std::floor(phase) < 0.5) ? 5.f : 0.f;
+}
+
+
+/** Renders a case for `duration` seconds.
+If `capture` is given, every output voltage is appended to it, frame by frame.
+*/
+static Result run(const Case& c, float duration = DURATION, std::vector<float>* capture = NULL) {
+	// Some modules read the engine sample rate in their constructor or onSampleRateChange().
+	if (APP->engine->getSampleRate() != c.sampleRate)
+		APP->engine->setSampleRate(c.sampleRate);
+
+	Module* module = c.model->createModule();
+	if (!c.mode.data.empty() || c.channels > 1) {
+		json_t* rootJ = c.mode.data.empty() ? json_object() : json_loads(c.mode.data.c_str(), 0, NULL);
+		if (rootJ) {
+			// Plaits allocates its voices off the audio thread, from the UI or from the patch data, so tell it how many to allocate
+			json_object_set_new(rootJ, "voices", json_integer(c.channels));
+			module->dataFromJson(rootJ);
+			json_decref(rootJ);
+		}
+	}
+
+	// Port::setChannels() is a no-op on disconnected ports, so connect every port directly.
+	int numInputs = module->inputs.size();
+	for (Input& input : module->inputs)
+		input.channels = c.channels;
+	for (Output& output : module->outputs)
+		output.channels = 1;
+
+	Module::ProcessArgs args;
+	args.sampleRate = c.sampleRate;
+	args.sampleTime = 1.f / c.sampleRate;
+
+	int numOutputs = module->outputs.size();
+	int blocks = std::ceil(duration * c.sampleRate / BLOCK_FRAMES);
+	if (capture) {
+		capture->clear();
+		capture->reserve((size_t) blocks * BLOCK_FRAMES * numOutputs * c.channels);
+	}
+	std::vector<double> blockNs(blocks);
+	std::vector<float> stimulus(BLOCK_FRAMES * numInputs * c.channels);
+	int64_t frame = 0;
+
+	for (int b = 0; b < blocks; b++) {
+		// Render stimulus outside of the timed region
+		for (int i = 0; i < BLOCK_FRAMES; i++) {
+			for (int j = 0; j < numInputs; j++) {
+				for (int k = 0; k < c.channels; k++) {
+					stimulus[(i * numInputs + j) * c.channels + k] = getStimulus(j, k, frame + i, args.sampleTime);
+				}
+			}
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < BLOCK_FRAMES; i++) {
+			const float* s = &stimulus[i * numInputs * c.channels];
+			for (int j = 0; j < numInputs; j++) {
+				for (int k = 0; k < c.channels; k++) {
+					module->inputs[j].setVoltage(s[j * c.channels + k], k);
+				}
+			}
+			module->process(args);
+			if (capture) {
+				for (int j = 0; j < numOutputs; j++) {
+					for (int k = 0; k < c.channels; k++) {
+						capture->push_back(module->outputs[j].getVoltage(k));
+					}
+				}
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		blockNs[b] = std::chrono::duration<double, std::nano>(end - start).count();
+		frame += BLOCK_FRAMES;
+	}
+
+	delete module;
+
+	Result result;
+	double total = 0.0;
+	for (double ns : blockNs)
+		total += ns;
+	std::sort(blockNs.begin(), blockNs.end());
+	result.nsPerSample = total / frame;
+	result.meanBlockNs = total / blocks;
+	result.peakBlockNs = blockNs.back();
+	result.p99BlockNs = blockNs[std::min(blocks - 1, (int) (0.99 * blocks))];
+	return result;
+}
+
+
+static void runModules(std::vector<std::string>& report) {
+	float sampleRate = APP->engine->getSampleRate();
+	report.push_back(string::f("Modules at %g Hz, %d frame blocks", sampleRate, BLOCK_FRAMES));
+	report.push_back(string::f("%-12s %-24s %3s %12s %12s %12s", "model", "mode", "ch", "ns/sample", "p99 us", "peak us"));
+
+	for (Model* model : pluginInstance->models) {
+		std::vector<int> channelCounts = {1};
+		if (isPolyphonic(model))
+			channelCounts.push_back(16);
+
+		for (const Mode& mode : getModes(model)) {
+			for (int channels : channelCounts) {
+				Result r = run({model, mode, sampleRate, channels});
+				std::string line = string::f("%-12s %-24s %3d %12.1f %12.2f %12.2f", model->slug.c_str(), mode.name.c_str(), channels, r.nsPerSample, r.p99BlockNs / 1000.0, r.peakBlockNs / 1000.0);
+				INFO("Benchmark: %s", line.c_str());
+				report.push_back(line);
+			}
+		}
+	}
+}
+
+
+/** Renders every Plaits engine at 1, 4 and 16 voices, at 44.1, 48 and 96 kHz, with and without low CPU mode, and tabulates the cost per voice. */
+static void runPlaits(std::vector<std::string>& report) {
+	Model* model = NULL;
+	for (Model* m : pluginInstance->models) {
+		if (m->slug == "Plaits")
+			model = m;
+	}
+	if (!model)
+		return;
+
+	const int channelCounts[] = {1, 4, 16};
+	report.push_back("");
+	report.push_back("Plaits engines, ns/sample per voice");
+	report.push_back(string::f("%-28s %8s %7s %10s %10s %10s", "engine", "rate", "low cpu", "1 voice", "4 voices", "16 voices"));
+
+	for (int engine = 0; engine < 16; engine++) {
+		for (float sampleRate : {44100.f, 48000.f, 96000.f}) {
+			for (bool lowCpu : {false, true}) {
+				Mode mode = {getPlaitsModelLabel(engine), string::f("{\"model\": %d, \"lowCpu\": %s}", engine, lowCpu ? "true" : "false")};
+				double nsPerVoice[3];
+				for (int i = 0; i < 3; i++) {
+					Result r = run({model, mode, sampleRate, channelCounts[i]}, PLAITS_DURATION);
+					nsPerVoice[i] = r.nsPerSample / channelCounts[i];
+				}
+				std::string line = string::f("%-28s %8g %7s %10.1f %10.1f %10.1f", mode.name.c_str(), sampleRate, lowCpu ? "yes" : "no", nsPerVoice[0], nsPerVoice[1], nsPerVoice[2]);
+				INFO("Benchmark: %s", line.c_str());
+				report.push_back(line);
+			}
+		}
+	}
+}
+
+
+struct GoldenCase {
+	Model* model;
+	Mode mode;
+	float sampleRate;
+};
+
+
+/** Returns the cases covered by the golden-output pass. */
+static std::vector<GoldenCase> getGoldenCases() {
+	std::vector<GoldenCase> cases;
+	for (Model* model : pluginInstance->models) {
+		if (model->slug == "Plaits") {
+			for (int i = 0; i < 16; i++)
+				cases.push_back({model, {string::f("engine %d", i), string::f("{\"model\": %d}", i)}, 48000.f});
+		}
+		else if (model->slug == "Clouds") {
+			for (int i = 0; i < 4; i++) {
+				for (int q = 0; q < 4; q++)
+					cases.push_back({model, {string::f("playback %d quality %d", i, q), string::f("{\"playback\": %d, \"quality\": %d}", i, q)}, 48000.f});
+			}
+		}
+		else if (model->slug == "Rings") {
+			for (int i = 0; i < 6; i++)
+				cases.push_back({model, {string::f("model %d", i), string::f("{\"model\": %d}", i)}, 48000.f});
+			cases.push_back({model, {"easter egg", "{\"easterEgg\": true}"}, 48000.f});
+		}
+		else if (model->slug == "Ripples" || model->slug == "Shelves") {
+			for (float sampleRate : {44100.f, 48000.f, 96000.f})
+				cases.push_back({model, {"default", ""}, sampleRate});
+		}
+	}
+	return cases;
+}
+
+
+static std::string getGoldenName(const GoldenCase& c) {
+	std::string name = string::f("%s-%s-%g", c.model->slug.c_str(), c.mode.name.c_str(), c.sampleRate);
+	std::replace(name.begin(), name.end(), ' ', '_');
+	return name;
+}
+
+
+/** FNV-1a hash of the output's bit patterns, for detecting any change at all */
+static std::string hashGolden(const std::vector<float>& output) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	const uint8_t* bytes = (const uint8_t*) output.data();
+	for (size_t i = 0; i < output.size() * sizeof(float); i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return string::f("%016llx", (unsigned long long) hash);
+}
+
+
+/** Returns the RMS level of each run of GOLDEN_ENVELOPE_FRAMES frames, across all outputs */
+static std::vector<float> getEnvelope(const std::vector<float>& output, int numOutputs) {
+	std::vector<float> envelope;
+	size_t len = (size_t) GOLDEN_ENVELOPE_FRAMES * numOutputs;
+	for (size_t i = 0; i < output.size(); i += len) {
+		size_t end = std::min(i + len, output.size());
+		double sum = 0.0;
+		for (size_t j = i; j < end; j++)
+			sum += (double) output[j] * output[j];
+		envelope.push_back(std::sqrt(sum / (end - i)));
+	}
+	return envelope;
+}
+
+
+/** Returns the RMS difference between two envelopes relative to the reference, in dB. */
+static double compareGolden(const std::vector<float>& envelope, const std::vector<float>& reference) {
+	double errorSum = 0.0;
+	double referenceSum = 0.0;
+	for (size_t i = 0; i < reference.size(); i++) {
+		double error = envelope[i] - reference[i];
+		errorSum += error * error;
+		referenceSum += (double) reference[i] * reference[i];
+	}
+	if (errorSum == 0.0)
+		return -INFINITY;
+	// Treat references quieter than 1 mV RMS as 1 mV so silent cases still compare absolutely
+	referenceSum = std::max(referenceSum, 1e-6 * reference.size());
+	return 10.0 * std::log10(errorSum / referenceSum);
+}
+
+
+static void runGolden(std::vector<std::string>& report) {
+	std::string referencePath = asset::plugin(pluginInstance, "src/benchmark/golden.json");
+	json_t* referencesJ = json_load_file(referencePath.c_str(), 0, NULL);
+	if (!referencesJ)
+		referencesJ = json_object();
+#ifdef GOLDEN_RECORD
+	json_t* recordJ = json_object();
+#endif
+
+	report.push_back("");
+	report.push_back(string::f("Golden outputs, tolerance %g dB, budget %gx", GOLDEN_TOLERANCE_DB, GOLDEN_BUDGET));
+	report.push_back(string::f("%-40s %8s %12s %12s  %s", "case", "diff dB", "ns/sample", "budget", "result"));
+
+	int failures = 0;
+	int unrecorded = 0;
+	std::vector<float> output;
+	for (const GoldenCase& c : getGoldenCases()) {
+		std::string name = getGoldenName(c);
+
+		// The engines draw from stmlib's process-wide generator, so reseed it for every case.
+		stmlib::Random::Seed(0x21);
+		Result r = run({c.model, c.mode, c.sampleRate, 1}, GOLDEN_DURATION, &output);
+		int numOutputs = output.size() / (size_t) (std::ceil(GOLDEN_DURATION * c.sampleRate / BLOCK_FRAMES) * BLOCK_FRAMES);
+		std::string hash = hashGolden(output);
+		std::vector<float> envelope = getEnvelope(output, numOutputs);
+
+#ifdef GOLDEN_RECORD
+		json_t* recordCaseJ = json_object();
+		json_object_set_new(recordCaseJ, "hash", json_string(hash.c_str()));
+		json_t* recordEnvelopeJ = json_array();
+		for (float x : envelope)
+			json_array_append_new(recordEnvelopeJ, json_real(x));
+		json_object_set_new(recordCaseJ, "envelope", recordEnvelopeJ);
+		json_object_set_new(recordCaseJ, "ns", json_real(r.nsPerSample));
+		json_object_set_new(recordJ, name.c_str(), recordCaseJ);
+#endif
+
+		std::string result;
+		double diffDb = -INFINITY;
+		double budget = 0.0;
+		json_t* caseJ = json_object_get(referencesJ, name.c_str());
+		json_t* hashJ = caseJ ? json_object_get(caseJ, "hash") : NULL;
+		json_t* envelopeJ = caseJ ? json_object_get(caseJ, "envelope") : NULL;
+		json_t* nsJ = caseJ ? json_object_get(caseJ, "ns") : NULL;
+		if (nsJ)
+			budget = json_number_value(nsJ) * GOLDEN_BUDGET;
+
+		if (!json_is_string(hashJ) || !json_is_array(envelopeJ)) {
+			result = "unrecorded";
+			unrecorded++;
+		}
+		else if (json_array_size(envelopeJ) != envelope.size()) {
+			result = "FAIL length";
+		}
+		else {
+			std::vector<float> reference;
+			for (size_t i = 0; i < json_array_size(envelopeJ); i++)
+				reference.push_back(json_number_value(json_array_get(envelopeJ, i)));
+			bool exact = (hash == json_string_value(hashJ));
+			diffDb = exact ? -INFINITY : compareGolden(envelope, reference);
+			if (diffDb > GOLDEN_TOLERANCE_DB)
+				result = "FAIL output";
+			else if (budget > 0.0 && r.nsPerSample > budget)
+				result = "FAIL budget";
+			else
+				result = exact ? "ok" : "ok, not bit-exact";
+		}
+		if (result.compare(0, 4, "FAIL") == 0)
+			failures++;
+
+		std::string line = string::f("%-40s %8.1f %12.1f %12.1f  %s", name.c_str(), diffDb, r.nsPerSample, budget, result.c_str());
+		INFO("Golden: %s", line.c_str());
+		report.push_back(line);
+	}
+	json_decref(referencesJ);
+
+#ifdef GOLDEN_RECORD
+	std::string recordPath = asset::user("AudibleInstruments-golden.json");
+	json_dump_file(recordJ, recordPath.c_str(), JSON_INDENT(2) | JSON_SORT_KEYS | JSON_REAL_PRECISION(9));
+	json_decref(recordJ);
+	report.push_back(string::f("Golden outputs recorded to %s", recordPath.c_str()));
+#endif
+
+	report.push_back(string::f("Golden outputs: %d failure(s), %d unrecorded", failures, unrecorded));
+	if (failures > 0)
+		WARN("Golden: %d case(s) failed", failures);
+}
+
+
+static void runAll() {
+	// Modules can only be created once the app and engine exist, which is after plugin init().
+	while (!APP || !APP->engine) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	// Match the engine thread's denormal handling so timings are comparable
+	_mm_setcsr(_mm_getcsr() | 0x8040);
+
+	// The cases change the engine's sample rate, so keep the engine from stepping the patch meanwhile
+	bool paused = APP->engine->isPaused();
+	APP->engine->setPaused(true);
+
+	INFO("Benchmark: starting");
+	float sampleRate = APP->engine->getSampleRate();
+	std::vector<std::string> report;
+	runModules(report);
+	runPlaits(report);
+	runGolden(report);
+	APP->engine->setSampleRate(sampleRate);
+	APP->engine->setPaused(paused);
+
+	std::string path = asset::user("AudibleInstruments-benchmark.txt");
+	FILE* file = std::fopen(path.c_str(), "w");
+	if (file) {
+		for (const std::string& line : report)
+			std::fprintf(file, "%s\n", line.c_str());
+		std::fclose(file);
+	}
+	INFO("Benchmark: finished, report written to %s", path.c_str());
+}
+
+
+} // namespace benchmark
+
+
+void startBenchmark() {
+	std::thread thread(benchmark::runAll);
+	thread.detach();
+}
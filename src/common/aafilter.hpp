@@ -0,0 +1,251 @@
+// Elliptic anti-aliasing filter design
+// Copyright (C) 2020 Tyler Coy
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <algorithm>
+#include "sos.hpp"
+
+namespace common
+{
+
+// Largest cascade the designer will produce. Specs that would need a higher
+// order are clamped to this, which trades away some stopband attenuation.
+static constexpr int kMaxNumSections = 8;
+
+struct AACascade
+{
+    int num_sections;
+    SOSCoefficients sections[kMaxNumSections];
+};
+
+// Elliptic filter design after S. J. Orfanidis, "Lecture Notes on Elliptic
+// Filter Design", using Landen transformations for the elliptic functions.
+namespace elliptic
+{
+
+typedef std::complex<double> Complex;
+
+static constexpr int kMaxLanden = 32;
+
+// Descending Landen sequence of moduli. Returns the sequence length.
+inline int Landen(double k, double* v)
+{
+    int m = 0;
+    while (m < kMaxLanden && k > 1e-15)
+    {
+        double kp = std::sqrt((1.0 - k) * (1.0 + k));
+        k = (k / (1.0 + kp)) * (k / (1.0 + kp));
+        v[m++] = k;
+    }
+    return m;
+}
+
+// Complete elliptic integral of the first kind K(k)
+inline double EllipK(double k)
+{
+    if (k < 1e-8)
+    {
+        return M_PI / 2.0;
+    }
+    double kp = std::sqrt((1.0 - k) * (1.0 + k));
+    if (kp < 1e-8)
+    {
+        // K(k) ~ ln(4/k') as k' -> 0
+        return std::log(4.0 / kp);
+    }
+    double v[kMaxLanden];
+    int m = Landen(k, v);
+    double K = M_PI / 2.0;
+    for (int n = 0; n < m; n++)
+    {
+        K *= 1.0 + v[n];
+    }
+    return K;
+}
+
+// Complementary integral K'(k) = K(sqrt(1 - k^2))
+inline double EllipKPrime(double k)
+{
+    if (k < 1e-8)
+    {
+        return std::log(4.0 / std::max(k, 1e-300));
+    }
+    return EllipK(std::sqrt((1.0 - k) * (1.0 + k)));
+}
+
+// Jacobi cd(uK, k) with u normalized to the quarter period
+inline Complex Cde(Complex u, double k)
+{
+    double v[kMaxLanden];
+    int m = Landen(k, v);
+    Complex w = std::cos(u * (M_PI / 2.0));
+    for (int n = m - 1; n >= 0; n--)
+    {
+        w = (1.0 + v[n]) * w / (1.0 + v[n] * w * w);
+    }
+    return w;
+}
+
+// Jacobi sn(uK, k) with u normalized to the quarter period
+inline Complex Sne(Complex u, double k)
+{
+    double v[kMaxLanden];
+    int m = Landen(k, v);
+    Complex w = std::sin(u * (M_PI / 2.0));
+    for (int n = m - 1; n >= 0; n--)
+    {
+        w = (1.0 + v[n]) * w / (1.0 + v[n] * w * w);
+    }
+    return w;
+}
+
+inline double SymmetricRemainder(double x, double y)
+{
+    return x - y * std::round(x / y);
+}
+
+// Inverse of Cde
+inline Complex Acde(Complex w, double k)
+{
+    double v[kMaxLanden];
+    int m = Landen(k, v);
+    for (int n = 0; n < m; n++)
+    {
+        double v1 = (n == 0) ? k : v[n - 1];
+        w = w / (1.0 + std::sqrt(1.0 - w * w * v1 * v1)) * 2.0 / (1.0 + v[n]);
+    }
+    Complex u = 2.0 / M_PI * std::acos(w);
+    double R = EllipKPrime(k) / EllipK(k);
+    return Complex(SymmetricRemainder(u.real(), 4.0),
+        SymmetricRemainder(u.imag(), 2.0 * R));
+}
+
+// Inverse of Sne
+inline Complex Asne(Complex w, double k)
+{
+    return 1.0 - Acde(w, k);
+}
+
+// Minimum order of a lowpass meeting the spec. wp and ws are normalized to
+// the Nyquist frequency. As with scipy's ellipord, a passband edge above the
+// stopband edge is treated as the mirrored spec.
+inline int Order(double wp, double ws, double rp, double rs)
+{
+    double passb = std::tan(M_PI * wp / 2.0);
+    double stopb = std::tan(M_PI * std::min(ws, 1.0) / 2.0);
+    double k = (wp < ws) ? (passb / stopb) : (stopb / passb);
+    double k1 = std::sqrt((std::pow(10.0, 0.1 * rp) - 1.0) /
+        (std::pow(10.0, 0.1 * rs) - 1.0));
+    double n = EllipK(k) * EllipKPrime(k1) / (EllipKPrime(k) * EllipK(k1));
+    return std::max(1, static_cast<int>(std::ceil(n - 1e-9)));
+}
+
+// Designs an even-order digital elliptic lowpass with passband edge wc,
+// normalized to the Nyquist frequency, and writes order/2 sections.
+// Each section has unity gain at DC, so the cascade does too.
+// Sections are ordered by increasing pole Q.
+inline void Design(int order, double wc, double rp, double rs,
+    SOSCoefficients* sections)
+{
+    int L = order / 2;
+    double ep = std::sqrt(std::pow(10.0, 0.1 * rp) - 1.0);
+    double es = std::sqrt(std::pow(10.0, 0.1 * rs) - 1.0);
+    double k1 = ep / es;
+
+    // Solve the degree equation for the selectivity k
+    double k1p = std::sqrt((1.0 - k1) * (1.0 + k1));
+    double prod = 1.0;
+    for (int i = 1; i <= L; i++)
+    {
+        double ui = (2.0 * i - 1.0) / order;
+        prod *= Sne(ui, k1p).real();
+    }
+    double kp = std::pow(k1p, order) * std::pow(prod, 4);
+    double k = std::sqrt((1.0 - kp) * (1.0 + kp));
+
+    double v0 = (Complex(0.0, -1.0) * Asne(Complex(0.0, 1.0 / ep), k1)).real()
+        / order;
+
+    // Prewarp the passband edge for the bilinear transform s = (z-1)/(z+1)
+    double warp = std::tan(M_PI * wc / 2.0);
+
+    for (int i = 1; i <= L; i++)
+    {
+        double ui = (2.0 * i - 1.0) / order;
+        double zeta = Cde(ui, k).real();
+        Complex za = Complex(0.0, 1.0 / (k * zeta)) * warp;
+        Complex pa = Complex(0.0, 1.0) * Cde(Complex(ui, -v0), k) * warp;
+
+        Complex zd = (1.0 + za) / (1.0 - za);
+        Complex pd = (1.0 + pa) / (1.0 - pa);
+
+        double b1 = -2.0 * zd.real();
+        double b2 = std::norm(zd);
+        double a1 = -2.0 * pd.real();
+        double a2 = std::norm(pd);
+        double g = (1.0 + a1 + a2) / (1.0 + b1 + b2);
+
+        SOSCoefficients& s = sections[L - i];
+        s.b[0] = g;
+        s.b[1] = g * b1;
+        s.b[2] = g * b2;
+        s.a[0] = a1;
+        s.a[1] = a2;
+    }
+}
+
+}
+
+// Designs, or fetches from a process-wide cache, an elliptic lowpass for a
+// system oversampled to oversampled_rate. The passband ends at fpass and the
+// stopband starts at fstop, both in Hz.
+inline const AACascade& DesignAAFilter(float oversampled_rate, float fpass,
+    float fstop, float rpass, float rstop)
+{
+    static std::mutex mutex;
+    static std::map<std::tuple<float, float, float, float, float>, AACascade>
+        cache;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto key = std::make_tuple(oversampled_rate, fpass, fstop, rpass, rstop);
+    auto it = cache.find(key);
+    if (it != cache.end())
+    {
+        return it->second;
+    }
+
+    double wp = 2.0 * fpass / oversampled_rate;
+    double ws = std::min(1.0, 2.0 * fstop / oversampled_rate);
+    int n = elliptic::Order(wp, ws, rpass, rstop);
+
+    // We are using second-order sections, so if the filter order would have
+    // been odd, we can bump it up by 1 for 'free'
+    n = 2 * ((n + 1) / 2);
+    n = std::min(n, 2 * kMaxNumSections);
+
+    AACascade& cascade = cache[key];
+    cascade.num_sections = n / 2;
+    elliptic::Design(n, wp, rpass, rstop, cascade.sections);
+    return cascade;
+}
+
+}
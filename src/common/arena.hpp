@@ -0,0 +1,107 @@
+#pragma once
+#include <rack.hpp>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#if defined ARCH_LIN
+	#include <sys/mman.h>
+#endif
+#if defined ARCH_WIN
+	#include <malloc.h>
+#endif
+
+using namespace rack;
+
+
+namespace common {
+
+
+static const size_t CACHE_LINE = 64;
+static const size_t HUGE_PAGE = 2 << 20;
+
+
+/** A single block of zeroed, cache-line-aligned memory holding a module's large DSP state.
+Reserve the total size once in the module's constructor, then carve engines and buffers out of it with create() and alloc().
+Every allocation starts on its own cache line, so engine state never shares a line with the module's params, lights or UI fields.
+With `hugePages`, the block is rounded up to 2 MB and Linux is asked to back it with transparent huge pages.
+*/
+struct Arena {
+	uint8_t* data = NULL;
+	size_t size = 0;
+	size_t used = 0;
+
+	Arena() {}
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	~Arena() {
+		release();
+	}
+
+	static size_t roundUp(size_t size, size_t alignment) {
+		return (size + alignment - 1) / alignment * alignment;
+	}
+
+	/** Returns the space `count` objects of type T take in an arena, for summing up the size to reserve. */
+	template <typename T>
+	static size_t footprint(size_t count = 1) {
+		return roundUp(count * sizeof(T), CACHE_LINE);
+	}
+
+	/** Frees any previous block and allocates a new zeroed one. Throws std::bad_alloc on failure. */
+	void reserve(size_t size, bool hugePages = false) {
+		release();
+		size_t alignment = hugePages ? HUGE_PAGE : CACHE_LINE;
+		size = roundUp(size, alignment);
+#if defined ARCH_WIN
+		data = (uint8_t*) _aligned_malloc(size, alignment);
+#else
+		void* p = NULL;
+		if (posix_memalign(&p, alignment, size) == 0)
+			data = (uint8_t*) p;
+#endif
+		if (!data)
+			throw std::bad_alloc();
+#if defined ARCH_LIN
+		if (hugePages)
+			madvise(data, size, MADV_HUGEPAGE);
+#endif
+		// Also touches every page up front, so the audio thread never takes the page faults
+		std::memset(data, 0, size);
+		this->size = size;
+		used = 0;
+	}
+
+	void release() {
+		if (!data)
+			return;
+#if defined ARCH_WIN
+		_aligned_free(data);
+#else
+		std::free(data);
+#endif
+		data = NULL;
+		size = 0;
+		used = 0;
+	}
+
+	/** Returns zeroed storage for `count` objects of type T without constructing them. */
+	template <typename T>
+	T* alloc(size_t count = 1) {
+		size_t len = footprint<T>(count);
+		assert(used + len <= size);
+		T* p = (T*) (data + used);
+		used += len;
+		return p;
+	}
+
+	/** Constructs an object in the arena. The caller runs its destructor before the arena is released. */
+	template <typename T>
+	T* create() {
+		return new (alloc<T>()) T();
+	}
+};
+
+
+} // namespace common
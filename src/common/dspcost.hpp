@@ -0,0 +1,158 @@
+#pragma once
+#include <rack.hpp>
+#include <atomic>
+#include <chrono>
+
+using namespace rack;
+
+
+namespace common {
+
+
+/** Opt-in meter of the time spent in the stages of a module's process() call.
+Call begin() before the first stage, lap() after each stage to charge the time since the previous mark to it, and endBlock() once per internal render block.
+When disabled, each call costs a single branch.
+setEnabled() may be called from the UI thread. It only sets flags, and the audio thread clears the figures itself at the next begin().
+*/
+struct DspCost {
+	enum Stage {
+		DSP,
+		SRC,
+		LIGHTS,
+		NUM_STAGES
+	};
+
+	typedef std::chrono::steady_clock Clock;
+
+	std::atomic<bool> enabled{false};
+	/** Set by setEnabled() and handled by the audio thread in begin() */
+	std::atomic<bool> resetRequested{false};
+	/** Rolling mean and max of the per-block cost of each stage, in nanoseconds. Written by the audio thread and read by the menu. */
+	std::atomic<float> meanNs[NUM_STAGES];
+	std::atomic<float> maxNs[NUM_STAGES];
+
+	float blockNs[NUM_STAGES] = {};
+	float windowMaxNs[NUM_STAGES] = {};
+	Clock::time_point lastTime;
+	Clock::time_point windowStart;
+
+	DspCost() {
+		for (int i = 0; i < NUM_STAGES; i++) {
+			meanNs[i] = 0.f;
+			maxNs[i] = 0.f;
+		}
+	}
+
+	void begin() {
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+		if (resetRequested.load(std::memory_order_relaxed) && resetRequested.exchange(false, std::memory_order_acquire))
+			reset();
+		lastTime = Clock::now();
+	}
+
+	void lap(Stage stage) {
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+		Clock::time_point now = Clock::now();
+		blockNs[stage] += std::chrono::duration<float, std::nano>(now - lastTime).count();
+		lastTime = now;
+	}
+
+	void setEnabled(bool enabled) {
+		if (enabled && !this->enabled)
+			resetRequested = true;
+		this->enabled = enabled;
+	}
+
+	/** Clears the figures. Only call from the audio thread, or before the module is added to the engine. */
+	void reset() {
+		for (int i = 0; i < NUM_STAGES; i++) {
+			meanNs[i] = 0.f;
+			maxNs[i] = 0.f;
+			blockNs[i] = 0.f;
+			windowMaxNs[i] = 0.f;
+		}
+		windowStart = Clock::now();
+		lastTime = windowStart;
+	}
+
+	void endBlock() {
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+		// The max is held for one second so it can be read from the menu.
+		bool windowEnd = (lastTime - windowStart >= std::chrono::seconds(1));
+		for (int i = 0; i < NUM_STAGES; i++) {
+			float mean = meanNs[i].load(std::memory_order_relaxed);
+			meanNs[i].store(mean + (blockNs[i] - mean) * (1 / 256.f), std::memory_order_relaxed);
+			windowMaxNs[i] = std::max(windowMaxNs[i], blockNs[i]);
+			blockNs[i] = 0.f;
+			if (windowEnd) {
+				maxNs[i].store(windowMaxNs[i], std::memory_order_relaxed);
+				windowMaxNs[i] = 0.f;
+			}
+		}
+		if (windowEnd)
+			windowStart = lastTime;
+	}
+
+	json_t* toJson() {
+		static const char* stageNames[NUM_STAGES] = {"dsp", "src", "lights"};
+		json_t* costJ = json_object();
+		json_object_set_new(costJ, "enabled", json_boolean(enabled));
+		if (enabled) {
+			for (int i = 0; i < NUM_STAGES; i++) {
+				json_t* stageJ = json_object();
+				json_object_set_new(stageJ, "meanUs", json_real(meanNs[i] / 1000.f));
+				json_object_set_new(stageJ, "maxUs", json_real(maxNs[i] / 1000.f));
+				json_object_set_new(costJ, stageNames[i], stageJ);
+			}
+		}
+		return costJ;
+	}
+
+	void fromJson(json_t* costJ) {
+		json_t* enabledJ = json_object_get(costJ, "enabled");
+		if (enabledJ)
+			setEnabled(json_boolean_value(enabledJ));
+	}
+};
+
+
+struct DspCostItem : MenuItem {
+	DspCost* cost;
+	void onAction(const event::Action& e) override {
+		cost->setEnabled(!cost->enabled);
+	}
+	void step() override {
+		rightText = CHECKMARK(cost->enabled);
+		MenuItem::step();
+	}
+};
+
+
+struct DspCostLabel : MenuLabel {
+	DspCost* cost;
+	int stage;
+	void step() override {
+		static const char* stageNames[DspCost::NUM_STAGES] = {"DSP", "SRC", "Lights"};
+		if (cost->enabled)
+			text = string::f("%s: mean %.2f µs, max %.2f µs per block", stageNames[stage], cost->meanNs[stage] / 1000.f, cost->maxNs[stage] / 1000.f);
+		else
+			text = string::f("%s: -", stageNames[stage]);
+		MenuLabel::step();
+	}
+};
+
+
+/** Appends the meter toggle and a live readout of the given stages to a context menu. */
+inline void appendDspCostMenu(Menu* menu, DspCost* cost, std::vector<int> stages) {
+	menu->addChild(new MenuSeparator);
+	menu->addChild(construct<DspCostItem>(&MenuItem::text, "Measure DSP cost", &DspCostItem::cost, cost));
+	for (int stage : stages) {
+		menu->addChild(construct<DspCostLabel>(&DspCostLabel::cost, cost, &DspCostLabel::stage, stage));
+	}
+}
+
+
+} // namespace common
@@ -0,0 +1,96 @@
+#pragma once
+#include <rack.hpp>
+#include <cstring>
+
+using namespace rack;
+
+
+namespace common {
+
+
+/** Recovers engines whose output has become non-finite.
+Pass each engine's output through check(). If it returns true, the caller resets that engine and silences its block.
+Denormals need no handling here, since Rack's engine threads and the WorkerPool's threads already run with flush-to-zero and denormals-are-zero.
+Building with `make DSP_GUARD=1` enables the guard by default. It can be toggled at runtime from the context menu either way.
+*/
+struct DspGuard {
+#ifdef DSP_GUARD
+	bool enabled = true;
+#else
+	bool enabled = false;
+#endif
+	/** Engine resets since the module was created or loaded */
+	int resets = 0;
+
+	/** Returns whether any sample is NaN or infinite, and counts the event. */
+	bool check(const float* x, int len) {
+		if (!enabled)
+			return false;
+		for (int i = 0; i < len; i++) {
+			if (!isFinite(x[i])) {
+				resets++;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool check(float x) {
+		return check(&x, 1);
+	}
+
+	/** Tests the exponent bits, which keeps working under -ffast-math */
+	static bool isFinite(float x) {
+		uint32_t bits;
+		std::memcpy(&bits, &x, sizeof(bits));
+		return (bits & 0x7f800000) != 0x7f800000;
+	}
+
+	json_t* toJson() {
+		json_t* guardJ = json_object();
+		json_object_set_new(guardJ, "enabled", json_boolean(enabled));
+		json_object_set_new(guardJ, "resets", json_integer(resets));
+		return guardJ;
+	}
+
+	void fromJson(json_t* guardJ) {
+		json_t* enabledJ = json_object_get(guardJ, "enabled");
+		if (enabledJ)
+			enabled = json_boolean_value(enabledJ);
+		json_t* resetsJ = json_object_get(guardJ, "resets");
+		if (resetsJ)
+			resets = json_integer_value(resetsJ);
+	}
+};
+
+
+struct DspGuardItem : MenuItem {
+	DspGuard* guard;
+	void onAction(const event::Action& e) override {
+		guard->enabled ^= true;
+	}
+	void step() override {
+		rightText = CHECKMARK(guard->enabled);
+		MenuItem::step();
+	}
+};
+
+
+struct DspGuardLabel : MenuLabel {
+	DspGuard* guard;
+	void step() override {
+		text = string::f("Engine resets: %d", guard->resets);
+		MenuLabel::step();
+	}
+};
+
+
+/** Appends the guard toggle and its reset counter to a context menu */
+inline void appendDspGuardMenu(Menu* menu, DspGuard* guard) {
+	menu->addChild(new MenuSeparator);
+	menu->addChild(construct<DspGuardItem>(&MenuItem::text, "Reset engine on NaN", &DspGuardItem::guard, guard));
+	menu->addChild(construct<DspGuardLabel>(&DspGuardLabel::guard, guard));
+}
+
+
+} // namespace common
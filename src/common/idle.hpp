@@ -0,0 +1,100 @@
+#pragma once
+#include <rack.hpp>
+
+using namespace rack;
+
+
+namespace common {
+
+
+/** Puts a block-based engine to sleep once its output has been silent for a while.
+Each block, push the control state with beginControls()/pushControl() and call isAsleep().
+If it returns false, render the block and report its output with processOutput().
+If it returns true, skip rendering and output exact zeros.
+Any change of a control value, or excitation reported by the module, wakes the engine for the current block.
+*/
+struct IdleDetector {
+	/** -120 dBFS relative to a full scale of 1 */
+	static constexpr float SILENCE = 1e-6f;
+
+	/** Seconds of continuous silence before falling asleep */
+	float holdTime = 1.f;
+	float silentTime = 0.f;
+	bool asleep = false;
+
+	std::vector<float> controls;
+	size_t controlIndex = 0;
+	bool controlsChanged = false;
+
+	void reset() {
+		silentTime = 0.f;
+		asleep = false;
+		controls.clear();
+	}
+
+	void beginControls() {
+		controlIndex = 0;
+		controlsChanged = false;
+	}
+
+	void pushControl(float x) {
+		if (controlIndex < controls.size()) {
+			if (controls[controlIndex] != x) {
+				controls[controlIndex] = x;
+				controlsChanged = true;
+			}
+		}
+		else {
+			controls.push_back(x);
+			controlsChanged = true;
+		}
+		controlIndex++;
+	}
+
+	/** Pushes every param value and every input voltage of a module. */
+	void pushModuleControls(Module* module) {
+		for (Param& param : module->params) {
+			pushControl(param.getValue());
+		}
+		for (Input& input : module->inputs) {
+			int channels = input.getChannels();
+			pushControl(channels);
+			for (int c = 0; c < channels; c++) {
+				pushControl(input.getVoltage(c));
+			}
+		}
+	}
+
+	/** Returns whether the current block can be skipped.
+		`excited` should be true when a trigger, gate, or non-silent audio input is present.
+	*/
+	bool isAsleep(bool excited) {
+		if (excited || controlsChanged) {
+			asleep = false;
+			silentTime = 0.f;
+		}
+		return asleep;
+	}
+
+	/** Reports the peak absolute value of a rendered block lasting `blockTime` seconds. */
+	void processOutput(float peak, float blockTime) {
+		if (peak >= SILENCE) {
+			silentTime = 0.f;
+			return;
+		}
+		silentTime += blockTime;
+		if (silentTime >= holdTime)
+			asleep = true;
+	}
+
+	static float getPeak(const float* x, int len, int stride = 1) {
+		float peak = 0.f;
+		for (int i = 0; i < len; i++) {
+			peak = std::max(peak, std::fabs(x[i * stride]));
+		}
+		return peak;
+	}
+};
+
+
+} // namespace common
@@ -0,0 +1,45 @@
+#pragma once
+#include <rack.hpp>
+
+using namespace rack;
+
+
+namespace common {
+
+
+/** Number of samples between light updates.
+At 48 kHz this is 1500 updates per second, still far above the UI frame rate.
+*/
+static const int LIGHT_DIVISION = 32;
+
+
+/** Holds the positive and negative peaks of a signal between light updates, so decimating the lights does not hide short transients.
+Call process() every sample and setLights() when the light divider fires.
+*/
+struct LightPeak {
+	float pos = 0.f;
+	float neg = 0.f;
+
+	void process(float x) {
+		pos = std::max(pos, x);
+		neg = std::min(neg, x);
+	}
+
+	/** Sets a green/red light pair to the scaled peaks and starts a new window. */
+	void setLights(Light* lights, float gain, float deltaTime) {
+		lights[0].setSmoothBrightness(pos * gain, deltaTime);
+		lights[1].setSmoothBrightness(-neg * gain, deltaTime);
+		pos = 0.f;
+		neg = 0.f;
+	}
+
+	/** Sets a single light to the scaled positive peak and starts a new window. */
+	void setLight(Light* light, float gain, float deltaTime) {
+		light->setSmoothBrightness(pos * gain, deltaTime);
+		pos = 0.f;
+		neg = 0.f;
+	}
+};
+
+
+} // namespace common
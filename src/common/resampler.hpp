@@ -0,0 +1,382 @@
+#pragma once
+#include <rack.hpp>
+#include <cassert>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <xmmintrin.h>
+
+using namespace rack;
+
+
+namespace common {
+
+
+/** Kaiser-windowed sinc kernel, tabulated at evenly spaced fractional delays.
+Row p holds the taps for a delay of p / phases input samples, so a fractional delay is served by linear interpolation between two rows.
+*/
+struct ResamplerKernel {
+	static const int BASE_TAPS = 48;
+	static const int MAX_TAPS = 512;
+	static const int PHASES = 128;
+
+	int inRate;
+	int outRate;
+	int baseTaps;
+	int taps;
+	/** (PHASES + 1) rows of taps coefficients */
+	std::vector<float> coefs;
+
+	/** `baseTaps` sets the kernel length when upsampling, and with it the delay of taps / 2 input frames. */
+	ResamplerKernel(int inRate, int outRate, int baseTaps = BASE_TAPS) {
+		this->inRate = inRate;
+		this->outRate = outRate;
+		this->baseTaps = baseTaps;
+		// When downsampling, the cutoff moves below the input Nyquist frequency and the kernel widens by the same ratio.
+		double ratio = std::min(1.0, (double) outRate / inRate);
+		taps = (int) std::ceil(baseTaps / ratio / 4) * 4;
+		taps = std::min(taps, (int) MAX_TAPS);
+		double cutoff = 0.9 * ratio;
+		const double beta = 7.0;
+
+		coefs.resize((PHASES + 1) * taps);
+		for (int p = 0; p <= PHASES; p++) {
+			float* row = &coefs[p * taps];
+			double mu = (double) p / PHASES;
+			double sum = 0.0;
+			for (int k = 0; k < taps; k++) {
+				// Distance in input samples from the output instant to tap k
+				double d = (k - (taps / 2 - 1)) - mu;
+				double x = d / (taps / 2);
+				double w = (std::fabs(x) < 1.0) ? bessel0(beta * std::sqrt(1.0 - x * x)) / bessel0(beta) : 0.0;
+				double h = cutoff * sinc(cutoff * d) * w;
+				row[k] = h;
+				sum += h;
+			}
+			// Normalize every phase to unity DC gain
+			for (int k = 0; k < taps; k++) {
+				row[k] /= sum;
+			}
+		}
+	}
+
+	static double sinc(double x) {
+		if (x == 0.0)
+			return 1.0;
+		x *= M_PI;
+		return std::sin(x) / x;
+	}
+
+	/** Zeroth-order modified Bessel function of the first kind */
+	static double bessel0(double x) {
+		double sum = 1.0;
+		double term = 1.0;
+		for (int i = 1; i < 64; i++) {
+			term *= (x / (2 * i)) * (x / (2 * i));
+			sum += term;
+			if (term < sum * 1e-12)
+				break;
+		}
+		return sum;
+	}
+
+	/** Returns the kernel for a rate pair and length, shared by every resampler in the process.
+	Takes a lock and may build the kernel, so call it from PolyphaseResampler::prepare() rather than from process().
+	The cache holds a reference to every kernel, so dropping one never frees it.
+	*/
+	static std::shared_ptr<const ResamplerKernel> get(int inRate, int outRate, int baseTaps = BASE_TAPS) {
+		static std::mutex cacheMutex;
+		static std::map<std::tuple<int, int, int>, std::shared_ptr<const ResamplerKernel>> cache;
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		std::shared_ptr<const ResamplerKernel>& kernel = cache[std::make_tuple(inRate, outRate, baseTaps)];
+		if (!kernel)
+			kernel = std::make_shared<ResamplerKernel>(inRate, outRate, baseTaps);
+		return kernel;
+	}
+};
+
+
+/** Polyphase FIR sample rate converter.
+Drop-in for dsp::SampleRateConverter, with the same process() contract: consume up to *inFrames, produce up to *outFrames, and write back the counts actually used.
+The output instant is tracked as an exact fraction of the reduced rate ratio, so there is no drift.
+Call prepare() for every rate pair and length that process() will use, from the module's constructor and onSampleRateChange(), so that setRates() and setBaseTaps() neither lock nor allocate on the audio thread.
+A pair that wasn't prepared outputs silence.
+*/
+template <int CHANNELS>
+struct PolyphaseResampler {
+	int channels = CHANNELS;
+	int inRate = 0;
+	int outRate = 0;
+	int baseTaps = ResamplerKernel::BASE_TAPS;
+	/** Rate ratio reduced by the GCD. Each output frame advances the input position by step / den. */
+	int step = 1;
+	int den = 1;
+	int frac = 0;
+	/** Input frames to push before the next output frame can be computed */
+	int needInput = 1;
+	/** Disabled channels are neither buffered nor convolved, and output zeros */
+	bool enabled[CHANNELS];
+
+	std::shared_ptr<const ResamplerKernel> kernel;
+	/** Set when the current rate pair and length weren't prepared. process() then outputs silence instead of building the kernel on the audio thread. */
+	bool unprepared = false;
+	static const int MAX_PREPARED = 4;
+	/** Kernels built by prepare(), most recent last. Older ones are replaced once all slots are used. */
+	std::shared_ptr<const ResamplerKernel> prepared[MAX_PREPARED];
+	int numPrepared = 0;
+	int taps = 0;
+	/** Per-channel history of 2 * taps samples, each sample written twice so the window is always contiguous */
+	std::vector<float> history;
+	int writePos = 0;
+
+	PolyphaseResampler() {
+		std::fill(enabled, enabled + CHANNELS, true);
+	}
+
+	/** Enables or disables conversion of one channel, e.g. when its output is unpatched. */
+	void setChannelEnabled(int c, bool enabled) {
+		if (enabled == this->enabled[c])
+			return;
+		this->enabled[c] = enabled;
+		// Resume from silence rather than from a stale window
+		if (enabled && !history.empty())
+			std::fill(&history[c * 2 * taps], &history[(c + 1) * 2 * taps], 0.f);
+	}
+
+	void setChannels(int channels) {
+		channels = clamp(channels, 0, CHANNELS);
+		if (channels == this->channels)
+			return;
+		// Clear the history of newly enabled channels
+		for (int c = this->channels; c < channels; c++) {
+			if (!history.empty())
+				std::fill(&history[c * 2 * taps], &history[(c + 1) * 2 * taps], 0.f);
+		}
+		this->channels = channels;
+	}
+
+	void setRates(int inRate, int outRate) {
+		if (inRate == this->inRate && outRate == this->outRate)
+			return;
+		this->inRate = inRate;
+		this->outRate = outRate;
+		refreshState();
+	}
+
+	/** Builds the kernel for a rate pair and length and sizes the history for it.
+	Must not run concurrently with process(), so call it from the constructor or onSampleRateChange().
+	*/
+	void prepare(int inRate, int outRate, int baseTaps = ResamplerKernel::BASE_TAPS) {
+		if (inRate <= 0 || outRate <= 0 || inRate == outRate)
+			return;
+		std::shared_ptr<const ResamplerKernel> k = ResamplerKernel::get(inRate, outRate, baseTaps);
+		if (findPrepared(inRate, outRate, baseTaps) != k)
+			prepared[numPrepared++ % MAX_PREPARED] = k;
+		if (history.size() < (size_t) CHANNELS * 2 * k->taps)
+			history.resize(CHANNELS * 2 * k->taps);
+	}
+
+	std::shared_ptr<const ResamplerKernel> findPrepared(int inRate, int outRate, int baseTaps) {
+		for (int i = 0; i < std::min(numPrepared, (int) MAX_PREPARED); i++) {
+			const std::shared_ptr<const ResamplerKernel>& k = prepared[i];
+			if (k->inRate == inRate && k->outRate == outRate && k->baseTaps == baseTaps)
+				return k;
+		}
+		return NULL;
+	}
+
+	/** Trades stopband rejection for latency. Shorter kernels delay the signal less. */
+	void setBaseTaps(int baseTaps) {
+		if (baseTaps == this->baseTaps)
+			return;
+		this->baseTaps = baseTaps;
+		refreshState();
+	}
+
+	void refreshState() {
+		frac = 0;
+		needInput = 1;
+		writePos = 0;
+		unprepared = false;
+		if (inRate <= 0 || outRate <= 0 || inRate == outRate) {
+			kernel = NULL;
+			return;
+		}
+		int g = gcd(inRate, outRate);
+		step = inRate / g;
+		den = outRate / g;
+
+		kernel = findPrepared(inRate, outRate, baseTaps);
+		if (!kernel) {
+			unprepared = true;
+			return;
+		}
+		taps = kernel->taps;
+		// prepare() sized the history for every kernel it built
+		assert(history.size() >= (size_t) CHANNELS * 2 * taps);
+		std::fill(history.begin(), history.begin() + CHANNELS * 2 * taps, 0.f);
+	}
+
+	void process(const dsp::Frame<CHANNELS>* in, int* inFrames, dsp::Frame<CHANNELS>* out, int* outFrames) {
+		if (!kernel) {
+			// Simply copy the buffer without conversion, or output silence if the rates differ but weren't prepared
+			int frames = std::min(*inFrames, *outFrames);
+			if (unprepared)
+				std::memset(out, 0, frames * sizeof(dsp::Frame<CHANNELS>));
+			else
+				std::memcpy(out, in, frames * sizeof(dsp::Frame<CHANNELS>));
+			*inFrames = frames;
+			*outFrames = frames;
+			return;
+		}
+
+		// Split the channels into the ones to convert and the ones to zero
+		int active[CHANNELS];
+		int activeCount = 0;
+		int inactive[CHANNELS];
+		int inactiveCount = 0;
+		for (int c = 0; c < channels; c++) {
+			if (enabled[c])
+				active[activeCount++] = c;
+			else
+				inactive[inactiveCount++] = c;
+		}
+
+		int inCount = 0;
+		int outCount = 0;
+		const float* coefs = kernel->coefs.data();
+		float phaseScale = (float) ResamplerKernel::PHASES / den;
+		alignas(16) float h[ResamplerKernel::MAX_TAPS];
+
+		while (true) {
+			// Push input until the window covers the next output instant
+			while (needInput > 0) {
+				if (inCount >= *inFrames)
+					goto done;
+				for (int i = 0; i < activeCount; i++) {
+					int c = active[i];
+					float* hist = &history[c * 2 * taps];
+					float x = in[inCount].samples[c];
+					hist[writePos] = x;
+					hist[writePos + taps] = x;
+				}
+				writePos++;
+				if (writePos >= taps)
+					writePos = 0;
+				inCount++;
+				needInput--;
+			}
+			if (outCount >= *outFrames)
+				break;
+
+			// Interpolate the kernel between the two nearest phases
+			float phase = frac * phaseScale;
+			int p = std::min((int) phase, ResamplerKernel::PHASES - 1);
+			simd::float_4 t = phase - p;
+			const float* h0 = &coefs[p * taps];
+			const float* h1 = h0 + taps;
+			for (int k = 0; k < taps; k += 4) {
+				simd::float_4 a = simd::float_4::load(&h0[k]);
+				simd::float_4 b = simd::float_4::load(&h1[k]);
+				(a + (b - a) * t).store(&h[k]);
+			}
+
+			// Convolve four channels' windows at a time, sharing each load of the kernel
+			int i = 0;
+			for (; i + 4 <= activeCount; i += 4) {
+				const float* x0 = &history[active[i + 0] * 2 * taps + writePos];
+				const float* x1 = &history[active[i + 1] * 2 * taps + writePos];
+				const float* x2 = &history[active[i + 2] * 2 * taps + writePos];
+				const float* x3 = &history[active[i + 3] * 2 * taps + writePos];
+				simd::float_4 acc0 = 0.f;
+				simd::float_4 acc1 = 0.f;
+				simd::float_4 acc2 = 0.f;
+				simd::float_4 acc3 = 0.f;
+				for (int k = 0; k < taps; k += 4) {
+					simd::float_4 hk = simd::float_4::load(&h[k]);
+					acc0 += simd::float_4::load(&x0[k]) * hk;
+					acc1 += simd::float_4::load(&x1[k]) * hk;
+					acc2 += simd::float_4::load(&x2[k]) * hk;
+					acc3 += simd::float_4::load(&x3[k]) * hk;
+				}
+				// Sum the four accumulators horizontally in one go
+				_MM_TRANSPOSE4_PS(acc0.v, acc1.v, acc2.v, acc3.v);
+				simd::float_4 sum = acc0 + acc1 + acc2 + acc3;
+				out[outCount].samples[active[i + 0]] = sum[0];
+				out[outCount].samples[active[i + 1]] = sum[1];
+				out[outCount].samples[active[i + 2]] = sum[2];
+				out[outCount].samples[active[i + 3]] = sum[3];
+			}
+			for (; i < activeCount; i++) {
+				int c = active[i];
+				const float* x = &history[c * 2 * taps + writePos];
+				simd::float_4 acc = 0.f;
+				for (int k = 0; k < taps; k += 4) {
+					acc += simd::float_4::load(&x[k]) * simd::float_4::load(&h[k]);
+				}
+				out[outCount].samples[c] = acc[0] + acc[1] + acc[2] + acc[3];
+			}
+			for (int i = 0; i < inactiveCount; i++) {
+				out[outCount].samples[inactive[i]] = 0.f;
+			}
+			outCount++;
+
+			// Advance the output instant
+			frac += step;
+			needInput = frac / den;
+			frac %= den;
+		}
+
+	done:
+		*inFrames = inCount;
+		*outFrames = outCount;
+	}
+
+	/** Advances over up to `inFrames` frames of silence without convolving.
+	Returns the number of output frames process() would have produced, at most `outFrames`.
+	*/
+	int skip(int inFrames, int outFrames) {
+		if (!kernel)
+			return std::min(inFrames, outFrames);
+
+		int inCount = 0;
+		int outCount = 0;
+		while (true) {
+			while (needInput > 0) {
+				if (inCount >= inFrames)
+					return outCount;
+				for (int c = 0; c < channels; c++) {
+					if (!enabled[c])
+						continue;
+					float* hist = &history[c * 2 * taps];
+					hist[writePos] = 0.f;
+					hist[writePos + taps] = 0.f;
+				}
+				writePos++;
+				if (writePos >= taps)
+					writePos = 0;
+				inCount++;
+				needInput--;
+			}
+			if (outCount >= outFrames)
+				return outCount;
+			outCount++;
+			frac += step;
+			needInput = frac / den;
+			frac %= den;
+		}
+	}
+
+	static int gcd(int a, int b) {
+		while (b != 0) {
+			int t = a % b;
+			a = b;
+			b = t;
+		}
+		return a;
+	}
+};
+
+
+} // namespace common
@@ -16,7 +16,7 @@
 
 #pragma once
 
-namespace ripples
+namespace common
 {
 
 struct SOSCoefficients
@@ -25,6 +25,11 @@ struct SOSCoefficients
     float a[2];
 };
 
+// Transposed direct form II cascade. Coefficients are stored pre-broadcast
+// to T, so a SIMD T filters all of its lanes with the same sections without
+// any per-sample shuffling. The sections run one after another, and each
+// caller decides what the lanes hold: Ripples and Shelves pack the signals
+// of one channel, and run a separate filter per channel.
 template <typename T, int max_num_sections>
 class SOSFilter
 {
@@ -56,26 +61,21 @@ public:
     {
         for (int n = 0; n < num_sections_; n++)
         {
-            x_[n][0] = 0.f;
-            x_[n][1] = 0.f;
-            x_[n][2] = 0.f;
+            s_[n][0] = 0.f;
+            s_[n][1] = 0.f;
         }
-
-        x_[num_sections_][0] = 0.f;
-        x_[num_sections_][1] = 0.f;
-        x_[num_sections_][2] = 0.f;
     }
 
     void SetCoefficients(const SOSCoefficients* sections)
     {
         for (int n = 0; n < num_sections_; n++)
         {
-            sections_[n].b[0] = sections[n].b[0];
-            sections_[n].b[1] = sections[n].b[1];
-            sections_[n].b[2] = sections[n].b[2];
+            b_[n][0] = sections[n].b[0];
+            b_[n][1] = sections[n].b[1];
+            b_[n][2] = sections[n].b[2];
 
-            sections_[n].a[0] = sections[n].a[0];
-            sections_[n].a[1] = sections[n].a[1];
+            a_[n][0] = sections[n].a[0];
+            a_[n][1] = sections[n].a[1];
         }
     }
 
@@ -83,36 +83,20 @@ public:
     {
         for (int n = 0; n < num_sections_; n++)
         {
-            // Shift x state
-            x_[n][2] = x_[n][1];
-            x_[n][1] = x_[n][0];
-            x_[n][0] = in;
-
-            T out = 0.f;
-
-            // Add x state
-            out += sections_[n].b[0] * x_[n][0];
-            out += sections_[n].b[1] * x_[n][1];
-            out += sections_[n].b[2] * x_[n][2];
-
-            // Subtract y state
-            out -= sections_[n].a[0] * x_[n+1][0];
-            out -= sections_[n].a[1] * x_[n+1][1];
+            T out = b_[n][0] * in + s_[n][0];
+            s_[n][0] = b_[n][1] * in - a_[n][0] * out + s_[n][1];
+            s_[n][1] = b_[n][2] * in - a_[n][1] * out;
             in = out;
         }
 
-        // Shift final section x state
-        x_[num_sections_][2] = x_[num_sections_][1];
-        x_[num_sections_][1] = x_[num_sections_][0];
-        x_[num_sections_][0] = in;
-
         return in;
     }
 
 protected:
     int num_sections_;
-    SOSCoefficients sections_[max_num_sections];
-    T x_[max_num_sections + 1][3];
+    T b_[max_num_sections][3];
+    T a_[max_num_sections][2];
+    T s_[max_num_sections][2];
 };
 
 }
@@ -0,0 +1,375 @@
+#pragma once
+#include <rack.hpp>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <xmmintrin.h>
+#if defined ARCH_LIN
+	#include <cerrno>
+	#include <semaphore.h>
+#elif defined ARCH_MAC
+	#include <dispatch/dispatch.h>
+#elif defined ARCH_WIN
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#endif
+
+using namespace rack;
+
+
+namespace common {
+
+
+/** Counting semaphore that spins briefly before sleeping in the OS.
+signal() is one atomic add, and only calls into the OS when the other side is asleep, so the engine thread can signal without taking a lock.
+*/
+struct Semaphore {
+	std::atomic<int> count{0};
+#if defined ARCH_LIN
+	sem_t sem;
+#elif defined ARCH_MAC
+	dispatch_semaphore_t sem;
+#elif defined ARCH_WIN
+	HANDLE sem;
+#endif
+
+	Semaphore() {
+#if defined ARCH_LIN
+		sem_init(&sem, 0, 0);
+#elif defined ARCH_MAC
+		sem = dispatch_semaphore_create(0);
+#elif defined ARCH_WIN
+		sem = CreateSemaphoreW(NULL, 0, INT_MAX, NULL);
+#endif
+	}
+
+	Semaphore(const Semaphore&) = delete;
+	Semaphore& operator=(const Semaphore&) = delete;
+
+	~Semaphore() {
+#if defined ARCH_LIN
+		sem_destroy(&sem);
+#elif defined ARCH_MAC
+		dispatch_release(sem);
+#elif defined ARCH_WIN
+		CloseHandle(sem);
+#endif
+	}
+
+	void signal() {
+		// A negative count means a thread is asleep in the OS semaphore
+		if (count.fetch_add(1, std::memory_order_release) < 0) {
+#if defined ARCH_LIN
+			sem_post(&sem);
+#elif defined ARCH_MAC
+			dispatch_semaphore_signal(sem);
+#elif defined ARCH_WIN
+			ReleaseSemaphore(sem, 1, NULL);
+#endif
+		}
+	}
+
+	/** Takes a signal if one is pending, without blocking */
+	bool tryWait() {
+		int c = count.load(std::memory_order_relaxed);
+		while (c > 0) {
+			if (count.compare_exchange_weak(c, c - 1, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+		return false;
+	}
+
+	void wait(int spins = 1000) {
+		for (int i = 0; i < spins; i++) {
+			if (tryWait())
+				return;
+			_mm_pause();
+		}
+		if (count.fetch_sub(1, std::memory_order_acquire) > 0)
+			return;
+#if defined ARCH_LIN
+		while (sem_wait(&sem) != 0 && errno == EINTR) {}
+#elif defined ARCH_MAC
+		dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER);
+#elif defined ARCH_WIN
+		WaitForSingleObject(sem, INFINITE);
+#endif
+	}
+};
+
+
+struct BlockWorker;
+
+
+/** Threads shared by the BlockWorkers of every module instance.
+The pool starts when the first BlockWorker joins it and stops when the last one leaves.
+Workers only join while their module renders on the pool, usually while its "Multithreaded" option is on, so patches that never use it run no extra threads.
+Joining and leaving happen on the UI thread or in the module's constructor, destructor and dataFromJson(), never in process().
+*/
+struct WorkerPool {
+	static const int MAX_WORKERS = 256;
+	static const int MAX_THREADS = 4;
+
+	std::vector<std::thread> threads;
+	std::atomic<bool> running{true};
+	Semaphore wake;
+	std::atomic<BlockWorker*> workers[MAX_WORKERS];
+	/** One past the highest slot ever used, so threads don't scan the whole table */
+	std::atomic<int> numSlots{0};
+	/** Odd while a thread is scanning the workers, so remove() can wait out a scan that may still hold the removed worker */
+	std::atomic<uint32_t> epochs[MAX_THREADS];
+
+	WorkerPool() {
+		for (int i = 0; i < MAX_WORKERS; i++)
+			workers[i] = NULL;
+		// Leave a core for the engine thread
+		int numThreads = clamp((int) std::thread::hardware_concurrency() - 1, 1, (int) MAX_THREADS);
+		for (int t = 0; t < numThreads; t++) {
+			epochs[t] = 0;
+			threads.emplace_back([this, t]() {
+				run(t);
+			});
+		}
+	}
+
+	~WorkerPool() {
+		running = false;
+		for (size_t t = 0; t < threads.size(); t++)
+			wake.signal();
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	static std::mutex& mutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	static WorkerPool*& instance() {
+		static WorkerPool* pool = NULL;
+		return pool;
+	}
+
+	static int& users() {
+		static int users = 0;
+		return users;
+	}
+
+	static WorkerPool* acquire() {
+		std::lock_guard<std::mutex> lock(mutex());
+		if (users()++ == 0)
+			instance() = new WorkerPool;
+		return instance();
+	}
+
+	static void release() {
+		std::lock_guard<std::mutex> lock(mutex());
+		if (--users() == 0) {
+			delete instance();
+			instance() = NULL;
+		}
+	}
+
+	/** Returns false if the table is full, in which case the worker runs its tasks on the engine thread */
+	bool add(BlockWorker* worker) {
+		for (int i = 0; i < MAX_WORKERS; i++) {
+			BlockWorker* empty = NULL;
+			if (workers[i].compare_exchange_strong(empty, worker)) {
+				int n = numSlots.load();
+				while (n < i + 1 && !numSlots.compare_exchange_weak(n, i + 1)) {}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void remove(BlockWorker* worker) {
+		for (int i = 0; i < MAX_WORKERS; i++) {
+			BlockWorker* w = worker;
+			workers[i].compare_exchange_strong(w, NULL);
+		}
+		for (size_t t = 0; t < threads.size(); t++) {
+			uint32_t epoch = epochs[t].load();
+			if (epoch & 1) {
+				while (epochs[t].load() == epoch)
+					std::this_thread::yield();
+			}
+		}
+	}
+
+	/** Wakes up to `count` threads. Lock-free, so the engine thread may call it. */
+	void notify(int count) {
+		count = std::min(count, (int) threads.size());
+		for (int i = 0; i < count; i++)
+			wake.signal();
+	}
+
+	void run(int t);
+};
+
+
+/** Runs a module's render job on the shared WorkerPool, one block at a time.
+Each block, the engine thread calls wait() to collect the previous block's result, fills the input for the next block, and calls post() with the number of tasks to split it into.
+The pool's threads run the tasks while the engine thread carries on, which adds exactly one block of latency.
+The job must only touch state that the engine thread leaves alone between post() and wait().
+The handoff is lock-free on the engine side. If the pool hasn't started every task by the time wait() is called, the engine thread runs the rest itself.
+A worker only uses the pool after setPooled(true). Until then, and after setPooled(false), wait() runs every task on the engine thread.
+*/
+struct BlockWorker {
+	/** Renders task `i` of the posted block */
+	std::function<void(int)> job;
+
+	/** The pool while pooled, or NULL. Written by setPooled() and read by post(). */
+	std::atomic<WorkerPool*> pool{NULL};
+	/** Set while post() may use `pool`, so setPooled(false) can wait until it is done */
+	std::atomic<bool> posting{false};
+	/** Tasks not yet claimed by a thread */
+	std::atomic<int> available{0};
+	/** Tasks not yet finished */
+	std::atomic<int> remaining{0};
+	/** Tasks in the posted block. Written before `available` is published. */
+	int count = 0;
+	/** Signaled when the last task of a block finishes */
+	Semaphore done;
+	/** Whether a block is posted and not yet collected. Only touched by the engine thread. */
+	bool inFlight = false;
+
+	BlockWorker() {}
+
+	BlockWorker(const BlockWorker&) = delete;
+	BlockWorker& operator=(const BlockWorker&) = delete;
+
+	/** The module's destructor must call wait() before freeing what the job touches */
+	~BlockWorker() {
+		wait();
+		setPooled(false);
+	}
+
+	/** Joins or leaves the shared pool, starting or stopping it if this is the first or last worker in it.
+	Call from the UI thread, the module's constructor or destructor, or dataFromJson(). Never from process().
+	*/
+	void setPooled(bool pooled) {
+		if (pooled == (pool.load() != NULL))
+			return;
+		if (pooled) {
+			WorkerPool* p = WorkerPool::acquire();
+			if (!p->add(this)) {
+				// The table is full, so keep running on the engine thread
+				WorkerPool::release();
+				return;
+			}
+			pool.store(p);
+		}
+		else {
+			WorkerPool* p = pool.exchange(NULL);
+			// Let a post() that loaded the pool before the exchange finish with it
+			while (posting.load())
+				std::this_thread::yield();
+			p->remove(this);
+			WorkerPool::release();
+		}
+	}
+
+	/** Starts a block of `count` tasks. The previous block must have been collected with wait() or isDone(). */
+	void post(int count = 1) {
+		assert(!inFlight);
+		if (count <= 0)
+			return;
+		this->count = count;
+		remaining.store(count, std::memory_order_relaxed);
+		available.store(count, std::memory_order_release);
+		inFlight = true;
+		posting.store(true);
+		WorkerPool* p = pool.load();
+		if (p)
+			p->notify(count);
+		posting.store(false);
+	}
+
+	/** Claims and runs one task of the posted block. Returns false if none are left to claim. */
+	bool runTask() {
+		int a = available.load(std::memory_order_relaxed);
+		while (a > 0) {
+			if (available.compare_exchange_weak(a, a - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+				job(count - a);
+				if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					done.signal();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/** Returns whether the posted block has finished, without blocking */
+	bool isDone() {
+		if (inFlight && done.tryWait())
+			inFlight = false;
+		return !inFlight;
+	}
+
+	/** Collects the posted block. Returns immediately if nothing is in flight. */
+	void wait() {
+		if (!inFlight)
+			return;
+		while (runTask()) {}
+		// Only tasks already running on the pool are left, so spin briefly before sleeping
+		done.wait();
+		inFlight = false;
+	}
+};
+
+
+inline void WorkerPool::run(int t) {
+	// Match the engine thread's flush-to-zero and denormals-are-zero modes
+	_mm_setcsr(_mm_getcsr() | 0x8040);
+
+	while (true) {
+		wake.wait();
+		if (!running)
+			break;
+		epochs[t]++;
+		// Keep going until no worker has an unclaimed task
+		bool ran;
+		do {
+			ran = false;
+			int n = numSlots.load();
+			for (int i = 0; i < n; i++) {
+				BlockWorker* worker = workers[i].load();
+				if (worker && worker->runTask())
+					ran = true;
+			}
+		} while (ran);
+		epochs[t]++;
+	}
+}
+
+
+/** Toggles a module's multithreaded render mode */
+struct MultithreadedItem : MenuItem {
+	bool* multithreaded;
+	BlockWorker* worker;
+	void onAction(const event::Action& e) override {
+		*multithreaded ^= true;
+		worker->setPooled(*multithreaded);
+	}
+	void step() override {
+		rightText = CHECKMARK(*multithreaded);
+		MenuItem::step();
+	}
+};
+
+
+/** Appends the multithreaded toggle to a context menu, which also joins or leaves the pool. `latency` describes the added delay. */
+inline void appendMultithreadedMenu(Menu* menu, bool* multithreaded, BlockWorker* worker, std::string latency) {
+	menu->addChild(new MenuSeparator);
+	menu->addChild(construct<MultithreadedItem>(&MenuItem::text, "Multithreaded", &MultithreadedItem::multithreaded, multithreaded, &MultithreadedItem::worker, worker));
+	menu->addChild(construct<MenuLabel>(&MenuLabel::text, "Adds " + latency + " of latency"));
+}
+
+
+} // namespace common
@@ -25,4 +25,8 @@ void init(rack::Plugin* p) {
 	p->addModel(modelStages);
 	p->addModel(modelRipples);
 	p->addModel(modelShelves);
+
+#ifdef BENCHMARK
+	startBenchmark();
+#endif
 }
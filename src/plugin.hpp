@@ -25,3 +25,10 @@ extern Model* modelStages;
 extern Model* modelMarbles;
 extern Model* modelRipples;
 extern Model* modelShelves;
+
+#ifdef BENCHMARK
+/** Runs the offline benchmark harness on a background thread. See src/benchmark/benchmark.cpp. */
+void startBenchmark();
+/** Returns the menu label of Plaits model `i`, for the per-engine table. */
+std::string getPlaitsModelLabel(int i);
+#endif